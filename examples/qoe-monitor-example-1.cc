@@ -47,6 +47,7 @@
 #include "ns3/ipv4-interface-container.h"
 #include "ns3/simulation-dataset.h"
 #include "ns3/h264-packetizer.h"
+#include "ns3/schedule-packetizer.h"
 #include "ns3/multimedia-application-sender.h"
 #include "ns3/multimedia-application-receiver.h"
 #include "ns3/multimedia-file-rebuilder.h"
@@ -90,14 +91,27 @@ main(int argc, char *argv[])
   bool enablePsnr = true;
   bool enableSsim = false;
 
+  /* Window of the original file to be transmitted, in seconds (a zero duration
+   * means the whole file) */
+  double windowStart = 0.0;
+  double windowDuration = 0.0;
+  bool windowEnabled = (windowStart > 0 || windowDuration > 0);
+
   /* Command line argument check */
-  if (argc != 2)
+  if (argc != 2 && argc != 3)
     {
       std::cout << "Wrong number of arguments.\n";
-      std::cout << "Usage: " << std::string(argv[0]) << " <input-264-file.mp4>\n";
+      std::cout << "Usage: " << std::string(argv[0])
+                << " <input-264-file.mp4> [<packet-schedule-file>]\n";
       exit(1);
     }
 
+  /* Packet schedule built by qoe-monitor-schedule-builder to be replayed instead of
+   * packetizing the input file (no schedule if it is not given). It must have been
+   * built from the same file, with the MTU, the NAL-aware setting and the window
+   * used here. */
+  std::string scheduleFilename((argc == 3) ? argv[2] : "");
+
   std::string jitterBufferLength("20ms");
   std::string simulationDuration("200s");
   std::string transmitterStartTime("2s");
@@ -127,13 +141,43 @@ main(int argc, char *argv[])
   dataset->SetReceivedCodedFile(receivedFilename);
   dataset->SetReceivedReconstructedFile(receivedRawFilename);
   dataset->SetTraceFileId(traceFileID);
+  dataset->SetUseContainerIndex(true);
+  dataset->SetNalAwarePacketization(true);
+  /* Virtual payloads save memory traffic on long runs, but they are left off here */
+  dataset->SetVirtualPayloads(false);
+  if (windowEnabled)
+    {
+      dataset->SetSourceWindow(windowStart, windowDuration);
+    }
 
-  Mpeg4Container mpeg4ReadingContainer = Mpeg4Container(dataset->GetOriginalCodedFile(),
-                                                        Container::READ, AVMEDIA_TYPE_VIDEO);
+  Mpeg4Container mpeg4ReadingContainer(dataset->GetOriginalCodedFile(),
+                                       Container::READ, AVMEDIA_TYPE_VIDEO);
+  mpeg4ReadingContainer.EnableIndex();
+  if (windowEnabled)
+    {
+      mpeg4ReadingContainer.SetWindow(windowStart, windowDuration);
+    }
   mpeg4ReadingContainer.InitForRead();
-  dataset->SetSamplingInterval(mpeg4ReadingContainer.GetSamplingInterval());
 
-  H264Packetizer videoPacketizer(mtu, dataset);
+  /* The replayed schedule carries the sampling interval it was built with */
+  Packetizer* videoPacketizer = NULL;
+  if (scheduleFilename.empty())
+    {
+      /* The packetizer reads from the container opened above */
+      videoPacketizer = new H264Packetizer(mtu, dataset, &mpeg4ReadingContainer);
+    }
+  else
+    {
+      SchedulePacketizer* schedulePacketizer = new SchedulePacketizer(mtu, dataset,
+                                                                      scheduleFilename);
+      if (!schedulePacketizer->IsValid())
+        {
+          std::cout << "Cannot replay " << scheduleFilename << ", abort.\n";
+          exit(1);
+        }
+      videoPacketizer = schedulePacketizer;
+    }
+  dataset->SetSamplingInterval(videoPacketizer->GetSamplingInterval());
 
   /* Network setup */
   NodeContainer nodes;
@@ -166,8 +210,8 @@ main(int argc, char *argv[])
 
   /* Receiver side application setup
    * First I create an mpeg4 container for the received file (output) */
-  Mpeg4Container mpeg4Container = Mpeg4Container(dataset->GetReceivedCodedFile(),
-                                                 Container::WRITE, AVMEDIA_TYPE_VIDEO);
+  Mpeg4Container mpeg4Container(dataset->GetReceivedCodedFile(),
+                                Container::WRITE, AVMEDIA_TYPE_VIDEO);
 
   /* Now I take the codec context from the reading context (input) and I copy
    * its settings to the output codec context */
@@ -196,7 +240,7 @@ main(int argc, char *argv[])
 
   /* Create the sender's side application */
   Ptr<MultimediaApplicationSender> multimediaSender = CreateObject<MultimediaApplicationSender>
-                                                      (nodes.Get(0), &videoPacketizer, dataset);
+                                                      (nodes.Get(0), videoPacketizer, dataset);
 
   multimediaSender->SetupDestinationAddress(interfaces.GetAddress(1), 400);
   nodes.Get(0)->AddApplication(multimediaSender);
@@ -227,6 +271,11 @@ main(int argc, char *argv[])
       std::cout.flush();
 
       PsnrMetric psnr;
+      if (windowEnabled)
+        {
+          psnr.SetReferenceWindow(mpeg4ReadingContainer.GetWindowFirstFrame(),
+                                mpeg4ReadingContainer.GetWindowFrameCount());
+        }
       psnr.EvaluateQoe(rawFilename, receivedRawFilename);
 
       /* Print the metric output without any header */
@@ -241,6 +290,11 @@ main(int argc, char *argv[])
       std::cout.flush();
 
       SsimMetric ssim;
+      if (windowEnabled)
+        {
+          ssim.SetReferenceWindow(mpeg4ReadingContainer.GetWindowFirstFrame(),
+                                mpeg4ReadingContainer.GetWindowFrameCount());
+        }
       ssim.EvaluateQoe(rawFilename, receivedRawFilename);
 
       /* Print the metric output without any header */
@@ -248,6 +302,7 @@ main(int argc, char *argv[])
       std::cout << " done!\n";
     }
 
+  delete videoPacketizer;
   delete dataset;
   Simulator::Destroy();
   return 0;
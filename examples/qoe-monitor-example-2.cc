@@ -112,6 +112,12 @@ main(int argc, char *argv[])
   bool enablePsnr = true;
   bool enableSsim = false;
 
+  /* Window of the original file to be transmitted, in seconds (a zero duration
+   * means the whole file) */
+  double windowStart = 0.0;
+  double windowDuration = 0.0;
+  bool windowEnabled = (windowStart > 0 || windowDuration > 0);
+
   bool enableCrossTraffic = true;
   bool isTcpCrossTraffic = false;
 
@@ -153,13 +159,27 @@ main(int argc, char *argv[])
   dataset->SetReceivedCodedFile(receivedFilename);
   dataset->SetReceivedReconstructedFile(receivedRawFilename);
   dataset->SetTraceFileId(traceFileID);
+  dataset->SetUseContainerIndex(true);
+  dataset->SetNalAwarePacketization(true);
+  /* Virtual payloads save memory traffic on long runs, but they are left off here */
+  dataset->SetVirtualPayloads(false);
+  if (windowEnabled)
+    {
+      dataset->SetSourceWindow(windowStart, windowDuration);
+    }
 
-  Mpeg4Container mpeg4ReadingContainer = Mpeg4Container(dataset->GetOriginalCodedFile(),
-                                                        Container::READ, AVMEDIA_TYPE_VIDEO);
+  Mpeg4Container mpeg4ReadingContainer(dataset->GetOriginalCodedFile(),
+                                       Container::READ, AVMEDIA_TYPE_VIDEO);
+  mpeg4ReadingContainer.EnableIndex();
+  if (windowEnabled)
+    {
+      mpeg4ReadingContainer.SetWindow(windowStart, windowDuration);
+    }
   mpeg4ReadingContainer.InitForRead();
   dataset->SetSamplingInterval(mpeg4ReadingContainer.GetSamplingInterval());
 
-  H264Packetizer videoPacketizer(mtu, dataset);
+  /* The packetizer reads from the container opened above, so the file is opened once */
+  H264Packetizer videoPacketizer(mtu, dataset, &mpeg4ReadingContainer);
 
   /* Network setup */
   NodeContainer nodes;
@@ -196,8 +216,8 @@ main(int argc, char *argv[])
 
   /* Receiver side application setup
    * First I create an mpeg4 container for the received file (output) */
-  Mpeg4Container mpeg4Container = Mpeg4Container(dataset->GetReceivedCodedFile(),
-                                                 Container::WRITE, AVMEDIA_TYPE_VIDEO);
+  Mpeg4Container mpeg4Container(dataset->GetReceivedCodedFile(),
+                                Container::WRITE, AVMEDIA_TYPE_VIDEO);
 
   /* Now I take the codec context from the reading context (input) and I copy
    * its settings to the output codec context */
@@ -307,6 +327,11 @@ main(int argc, char *argv[])
       std::cout.flush();
 
       PsnrMetric psnr;
+      if (windowEnabled)
+        {
+          psnr.SetReferenceWindow(mpeg4ReadingContainer.GetWindowFirstFrame(),
+                                mpeg4ReadingContainer.GetWindowFrameCount());
+        }
       psnr.EvaluateQoe(rawFilename, receivedRawFilename);
 
       /* Print the metric output without any header */
@@ -321,6 +346,11 @@ main(int argc, char *argv[])
       std::cout.flush();
 
       SsimMetric ssim;
+      if (windowEnabled)
+        {
+          ssim.SetReferenceWindow(mpeg4ReadingContainer.GetWindowFirstFrame(),
+                                mpeg4ReadingContainer.GetWindowFrameCount());
+        }
       ssim.EvaluateQoe(rawFilename, receivedRawFilename);
 
       /* Print the metric output without any header */
@@ -0,0 +1,110 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Alessandro Paganelli <alessandro.paganelli@unimore.it>
+ *          Daniela Saladino <daniela.saladino@unimore.it>
+ *
+ **************************************************************************************************
+ *
+ * Description: offline tool which packetizes an input file once and stores the result
+ * into a packet schedule. The schedule can then be replayed by a SchedulePacketizer in
+ * place of the H264Packetizer/PcmMuLawPacketizer, so that repeated simulations over the
+ * same file neither demux nor packetize it again:
+ *
+ *      SchedulePacketizer videoPacketizer(mtu, dataset, "<schedule-file>");
+ *
+ * (e.g., qoe-monitor-example-1 replays the schedule given as its second argument).
+ * A .wav input file is packetized as PCM mu-law audio, any other file as h264 video.
+ * The MTU, the NAL-aware packetization setting (0 or 1) and, optionally, the source
+ * window (start offset and duration, in seconds) are given on the command line and
+ * must match the ones of the simulations: the schedule records them, together with the
+ * size, the modification time and the type of the input file, and the
+ * SchedulePacketizer refuses it if any of them differs.
+ */
+
+#include "ns3/simulation-dataset.h"
+#include "ns3/h264-packetizer.h"
+#include "ns3/pcm-mu-law-packetizer.h"
+#include "ns3/schedule-packetizer.h"
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+
+using namespace ns3;
+
+int
+main(int argc, char *argv[])
+{
+  /* Command line argument check */
+  if (argc != 5 && argc != 7)
+    {
+      std::cout << "Wrong number of arguments.\n";
+      std::cout << "Usage: " << std::string(argv[0])
+                << " <input-file> <output-schedule-file> <mtu> <nal-aware-packetization>"
+                << " [<window-start> <window-duration>]\n";
+      exit(1);
+    }
+
+  std::string inputFilename(argv[1]);
+  std::string scheduleFilename(argv[2]);
+
+  /* Packetization parameters: they must match the ones of the simulations */
+  int mtu = atoi(argv[3]);
+  bool nalAwarePacketization = (atoi(argv[4]) != 0);
+  double windowStart = (argc == 7) ? atof(argv[5]) : 0.0;
+  double windowDuration = (argc == 7) ? atof(argv[6]) : 0.0;
+
+  if (mtu <= _IP_HEADER_LENGTH + _UDP_HEADER_LENGTH + _RTP_HEADER_LENGTH + 2 ||
+      windowStart < 0 || windowDuration < 0)
+    {
+      std::cout << "Invalid MTU or source window.\n";
+      exit(1);
+    }
+
+  SimulationDataset* dataset = new SimulationDataset();
+  dataset->SetOriginalCodedFile(inputFilename);
+  dataset->SetUseContainerIndex(true);
+  dataset->SetNalAwarePacketization(nalAwarePacketization);
+  if (windowStart > 0 || windowDuration > 0)
+    {
+      dataset->SetSourceWindow(windowStart, windowDuration);
+    }
+
+  Packetizer* packetizer = NULL;
+  size_t extPosition = inputFilename.rfind(".wav");
+  if (extPosition != std::string::npos && extPosition == inputFilename.size() - 4)
+    {
+      dataset->SetFileType(SimulationDataset::AUDIO);
+      packetizer = new PcmMuLawPacketizer(mtu, dataset);
+    }
+  else
+    {
+      dataset->SetFileType(SimulationDataset::VIDEO);
+      packetizer = new H264Packetizer(mtu, dataset);
+    }
+
+  bool result = SchedulePacketizer::BuildSchedule(packetizer, dataset, scheduleFilename);
+  if (result)
+    {
+      std::cout << "Packet schedule " << scheduleFilename << " written: "
+                << dataset->GetPacketTraceSize() << " packets\n";
+    }
+
+  delete packetizer;
+  delete dataset;
+
+  return result ? 0 : 1;
+}
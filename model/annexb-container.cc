@@ -0,0 +1,268 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Alessandro Paganelli <alessandro.paganelli@unimore.it>
+ *          Daniela Saladino <daniela.saladino@unimore.it>
+ */
+
+
+#include "annexb-container.h"
+
+#define _ANNEXB_CONTAINER_DEBUG 0
+
+namespace ns3
+{
+
+  static const uint8_t g_startCode[4] = { 0x00, 0x00, 0x00, 0x01 };
+
+  AnnexBContainer::AnnexBContainer(std::string filename, enum Mode openMode,
+                                   enum AVMediaType type) :
+                                   Container(filename, openMode, type),
+                                   m_writeBuffer()
+  {
+    m_copyCodecContextAvailable = false;
+    m_copyStreamAvailable = false;
+    m_outputFile = NULL;
+    m_nalLengthSize = 0;
+  }
+
+  AnnexBContainer::~AnnexBContainer()
+  {
+    if (m_outputFile != NULL)
+      {
+        FinalizeFile();
+      }
+  }
+
+  bool
+  AnnexBContainer::EnableAsyncWrite(unsigned int /* bufferSize */)
+  {
+    /* The output is written by the container itself, not through the muxer */
+    std::cout << "AnnexBContainer: Asynchronous write is not supported\n";
+    return false;
+  }
+
+  bool
+  AnnexBContainer::InitForWrite()
+  {
+    if (m_modeOfOperation != WRITE || !m_copyCodecContextAvailable)
+      {
+        return false;
+      }
+
+    if (m_memoryBuffer != NULL)
+      {
+        std::cout << "AnnexBContainer: Memory buffers are not supported\n";
+        return false;
+      }
+
+    if (m_copyCodecContext.codec_id != CODEC_ID_H264)
+      {
+        std::cout << "AnnexBContainer: only H.264 streams are supported\n";
+        return false;
+      }
+
+    m_outputFile = fopen(m_filename.c_str(), "wb");
+    if (m_outputFile == NULL)
+      {
+        std::cout << "AnnexBContainer: Could not open output file\n";
+        return false;
+      }
+
+    m_writeBuffer.reserve(_ANNEXB_WRITE_BUFFER_SIZE);
+
+    /* Set the actual time-base unit */
+    m_timeUnit = ((float) m_copyCodecContext.time_base.num) / (m_copyCodecContext.time_base.den);
+
+    /* The parameter sets have to precede any slice */
+    if (!ParseConfiguration(m_copyCodecContext.extradata, m_copyCodecContext.extradata_size))
+      {
+        std::cout << "AnnexBContainer: invalid codec configuration\n";
+        fclose(m_outputFile);
+        m_outputFile = NULL;
+        return false;
+      }
+
+    return true;
+  }
+
+  bool
+  AnnexBContainer::ParseConfiguration(const uint8_t* extradata, unsigned int size)
+  {
+    if (extradata == NULL || size == 0 || extradata[0] != 1)
+      {
+        /* No AVCC configuration record: the stream already carries start codes
+         * and its parameter sets, if any, are copied as they are */
+        m_nalLengthSize = 0;
+        if (extradata != NULL && size > 0)
+          {
+            WriteData(extradata, size);
+          }
+        return true;
+      }
+
+    /* AVCC record: version, profile, compatibility, level, length size, then
+     * the SPS and PPS sets, each one prefixed by a 16-bit length */
+    if (size < 7)
+      {
+        return false;
+      }
+
+    m_nalLengthSize = (extradata[4] & 0x03) + 1;
+
+    unsigned int offset = 5;
+    for (unsigned int set = 0; set < 2; set++)
+      {
+        if (offset >= size)
+          {
+            return false;
+          }
+
+        /* The SPS count is on 5 bits, the PPS count on 8 bits */
+        unsigned int count = (set == 0) ? (extradata[offset] & 0x1F) : extradata[offset];
+        offset++;
+
+        for (unsigned int i = 0; i < count; i++)
+          {
+            if (offset + 2 > size)
+              {
+                return false;
+              }
+
+            unsigned int length = (extradata[offset] << 8) | extradata[offset + 1];
+            offset += 2;
+
+            if (offset + length > size)
+              {
+                return false;
+              }
+
+            WriteNalUnit(extradata + offset, length);
+            offset += length;
+          }
+      }
+
+    return true;
+  }
+
+  bool
+  AnnexBContainer::PacketizeFromQueue()
+  {
+    /* As for Mpeg4, it is possible to dequeue exactly one packet per round */
+    unsigned int packetSize = m_packetLengthQueue.front();
+
+    m_rtpHeaderQueue.pop();
+    m_packetLengthQueue.pop();
+
+    const uint8_t* data = ReadPacketizationData(packetSize);
+
+    if (m_nalLengthSize == 0)
+      {
+        WriteData(data, packetSize);
+        return true;
+      }
+
+    /* Each length prefix is replaced by a start code */
+    unsigned int offset = 0;
+    while (offset + m_nalLengthSize <= packetSize)
+      {
+        unsigned int nalSize = 0;
+        for (unsigned int i = 0; i < m_nalLengthSize; i++)
+          {
+            nalSize = (nalSize << 8) | data[offset + i];
+          }
+        offset += m_nalLengthSize;
+
+        if (nalSize > packetSize - offset)
+          {
+            /* The packet has been damaged (e.g., by the loss of a fragment):
+             * I keep only the part that has been received */
+#if _ANNEXB_CONTAINER_DEBUG
+            std::cout << "AnnexBContainer: truncated NAL unit of " << nalSize << " bytes\n";
+#endif
+            nalSize = packetSize - offset;
+          }
+
+        if (nalSize > 0)
+          {
+            WriteNalUnit(data + offset, nalSize);
+          }
+        offset += nalSize;
+      }
+
+    return true;
+  }
+
+  void
+  AnnexBContainer::WriteNalUnit(const uint8_t* data, unsigned int size)
+  {
+    WriteData(g_startCode, sizeof(g_startCode));
+    WriteData(data, size);
+  }
+
+  void
+  AnnexBContainer::WriteData(const uint8_t* data, unsigned int size)
+  {
+    if (m_writeBuffer.size() + size > _ANNEXB_WRITE_BUFFER_SIZE)
+      {
+        FlushBuffer();
+      }
+
+    if (size >= _ANNEXB_WRITE_BUFFER_SIZE)
+      {
+        /* Large blocks are written directly */
+        fwrite(data, 1, size, m_outputFile);
+        return;
+      }
+
+    m_writeBuffer.insert(m_writeBuffer.end(), data, data + size);
+  }
+
+  bool
+  AnnexBContainer::FlushBuffer()
+  {
+    if (m_writeBuffer.size() == 0)
+      {
+        return true;
+      }
+
+    bool result = (fwrite(&m_writeBuffer[0], 1, m_writeBuffer.size(), m_outputFile)
+                   == m_writeBuffer.size());
+    m_writeBuffer.clear();
+
+    if (!result)
+      {
+        std::cout << "AnnexBContainer: Error while writing the output file\n";
+      }
+
+    return result;
+  }
+
+  bool
+  AnnexBContainer::FinalizeFile()
+  {
+    if (m_outputFile == NULL)
+      {
+        return false;
+      }
+
+    bool result = FlushBuffer();
+    fclose(m_outputFile);
+    m_outputFile = NULL;
+
+    return result;
+  }
+
+}
@@ -0,0 +1,86 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Alessandro Paganelli <alessandro.paganelli@unimore.it>
+ *          Daniela Saladino <daniela.saladino@unimore.it>
+ */
+
+
+#ifndef ANNEXB_CONTAINER_H_
+#define ANNEXB_CONTAINER_H_
+
+#include <cstdio>
+#include <vector>
+#include "container.h"
+
+/* Size of the buffer collecting the output before it is written to disk */
+#define _ANNEXB_WRITE_BUFFER_SIZE 1048576
+
+namespace ns3
+{
+
+  /* Container writing a raw H.264 elementary stream (Annex B byte-stream format): each
+   * NAL unit of the received packets, length-prefixed as in mp4 files (AVCC), is written
+   * preceded by a start code. Since the output has no index to be finalized, it can be
+   * decoded while it is being written. Reading is not supported, and neither are the
+   * asynchronous output mode and the memory buffers, since the output file is written
+   * directly. */
+  class AnnexBContainer : public ns3::Container
+  {
+  public:
+    AnnexBContainer(std::string filename, enum Mode openMode, enum AVMediaType type);
+
+    virtual
+    ~AnnexBContainer();
+
+    virtual bool
+    InitForWrite();
+
+    virtual bool
+    EnableAsyncWrite(unsigned int bufferSize);
+
+    /* Methods inherited from Container that have to be implemented. */
+    virtual bool
+    FinalizeFile();
+  protected:
+    virtual bool
+    PacketizeFromQueue();
+
+    FILE* m_outputFile;
+
+    /* Buffer written to the file only when full (or at finalization) */
+    std::vector<uint8_t> m_writeBuffer;
+
+    /* Size of the NAL unit length prefix used by the input stream; zero when the
+     * input stream is already in Annex B format */
+    unsigned int m_nalLengthSize;
+
+    /* Method used to parse the AVCC configuration record, writing the parameter
+     * sets it contains */
+    bool
+    ParseConfiguration(const uint8_t* extradata, unsigned int size);
+
+    /* Methods used to append data to the output */
+    void
+    WriteNalUnit(const uint8_t* data, unsigned int size);
+    void
+    WriteData(const uint8_t* data, unsigned int size);
+    bool
+    FlushBuffer();
+  };
+
+}
+
+#endif /* ANNEXB_CONTAINER_H_ */
@@ -0,0 +1,139 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Alessandro Paganelli <alessandro.paganelli@unimore.it>
+ *          Daniela Saladino <daniela.saladino@unimore.it>
+ */
+
+
+#include <algorithm>
+#include "byte-ring-buffer.h"
+
+namespace ns3
+{
+
+#define _BYTE_RING_BUFFER_DEFAULT_CAPACITY 4096
+
+  ByteRingBuffer::ByteRingBuffer() :
+                                 m_buffer(_BYTE_RING_BUFFER_DEFAULT_CAPACITY),
+                                 m_head(0),
+                                 m_size(0)
+  {
+  }
+
+  ByteRingBuffer::ByteRingBuffer(unsigned int capacity) :
+                                 m_buffer(capacity > 0 ? capacity : 1),
+                                 m_head(0),
+                                 m_size(0)
+  {
+  }
+
+  void
+  ByteRingBuffer::Write(const uint8_t* data, unsigned int length)
+  {
+    if (m_size + length > m_buffer.size())
+      {
+        Grow(m_size + length);
+      }
+
+    unsigned int capacity = m_buffer.size();
+    unsigned int tail = (m_head + m_size) % capacity;
+
+    /* At most two copies: up to the end of the buffer and from its beginning */
+    unsigned int firstChunk = std::min(length, capacity - tail);
+    memcpy(&m_buffer[tail], data, firstChunk);
+    if (length > firstChunk)
+      {
+        memcpy(&m_buffer[0], data + firstChunk, length - firstChunk);
+      }
+
+    m_size += length;
+  }
+
+  unsigned int
+  ByteRingBuffer::Read(uint8_t* data, unsigned int length)
+  {
+    unsigned int readBytes = 0;
+    while (readBytes < length && m_size > 0)
+      {
+        unsigned int available = 0;
+        const uint8_t* span = Peek(&available);
+        unsigned int chunk = std::min(available, length - readBytes);
+
+        memcpy(data + readBytes, span, chunk);
+        Consume(chunk);
+        readBytes += chunk;
+      }
+
+    return readBytes;
+  }
+
+  const uint8_t*
+  ByteRingBuffer::Peek(unsigned int* length)
+  {
+    *length = std::min(m_size, (unsigned int) m_buffer.size() - m_head);
+    return &m_buffer[m_head];
+  }
+
+  void
+  ByteRingBuffer::Consume(unsigned int length)
+  {
+    length = std::min(length, m_size);
+    m_head = (m_head + length) % m_buffer.size();
+    m_size -= length;
+
+    if (m_size == 0)
+      {
+        /* Restart from the beginning, to maximize the contiguous spans */
+        m_head = 0;
+      }
+  }
+
+  unsigned int
+  ByteRingBuffer::GetSize()
+  {
+    return m_size;
+  }
+
+  unsigned int
+  ByteRingBuffer::GetCapacity()
+  {
+    return m_buffer.size();
+  }
+
+  void
+  ByteRingBuffer::Clear()
+  {
+    m_head = 0;
+    m_size = 0;
+  }
+
+  /* The capacity is at least doubled, and the stored data is moved to the
+   * beginning of the new buffer */
+  void
+  ByteRingBuffer::Grow(unsigned int minimumCapacity)
+  {
+    unsigned int newCapacity = std::max((unsigned int) m_buffer.size() * 2, minimumCapacity);
+    std::vector<uint8_t> newBuffer(newCapacity);
+
+    unsigned int storedBytes = m_size;
+    Read(newBuffer.empty() ? NULL : &newBuffer[0], storedBytes);
+
+    m_buffer.swap(newBuffer);
+    m_head = 0;
+    m_size = storedBytes;
+  }
+
+} // namespace ns3
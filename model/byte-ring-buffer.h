@@ -0,0 +1,78 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Alessandro Paganelli <alessandro.paganelli@unimore.it>
+ *          Daniela Saladino <daniela.saladino@unimore.it>
+ */
+
+
+#ifndef BYTE_RING_BUFFER_H_
+#define BYTE_RING_BUFFER_H_
+
+#include <vector>
+#include <cstring>
+#include "stdint.h"
+
+namespace ns3
+{
+
+  /* Contiguous, growable circular byte buffer. Data is written and read in blocks;
+   * Peek returns the longest contiguous readable span, so that callers can process
+   * data in place without copying it. */
+  class ByteRingBuffer
+  {
+  public:
+    ByteRingBuffer();
+    ByteRingBuffer(unsigned int capacity);
+
+    /* Append length bytes, growing the buffer if needed */
+    void
+    Write(const uint8_t* data, unsigned int length);
+
+    /* Copy (up to) length bytes into data and remove them from the buffer.
+     * Returns the number of bytes actually read. */
+    unsigned int
+    Read(uint8_t* data, unsigned int length);
+
+    /* Return a pointer to the first readable byte, and store in length the number of
+     * bytes that can be read contiguously from it. */
+    const uint8_t*
+    Peek(unsigned int* length);
+
+    /* Remove (up to) length bytes from the buffer */
+    void
+    Consume(unsigned int length);
+
+    unsigned int
+    GetSize();
+    unsigned int
+    GetCapacity();
+    void
+    Clear();
+
+  protected:
+    std::vector<uint8_t> m_buffer;
+
+    /* Index of the first readable byte and number of stored bytes */
+    unsigned int m_head;
+    unsigned int m_size;
+
+    void
+    Grow(unsigned int minimumCapacity);
+  };
+
+} // namespace ns3
+
+#endif /* BYTE_RING_BUFFER_H_ */
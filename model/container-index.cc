@@ -0,0 +1,337 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Alessandro Paganelli <alessandro.paganelli@unimore.it>
+ *          Daniela Saladino <daniela.saladino@unimore.it>
+ */
+
+
+#include <cstring>
+#include <sys/stat.h>
+#include "container-index.h"
+
+namespace ns3
+{
+
+  /* Identifier and version of the sidecar file format */
+#define _CONTAINER_INDEX_MAGIC 0x51494458
+#define _CONTAINER_INDEX_VERSION 3
+
+  ContainerIndex::ContainerIndex()
+  {
+    memset(&m_parameters, 0, sizeof(m_parameters));
+    m_parameters.m_streamNumber = -1;
+    m_parameters.m_codecType = AVMEDIA_TYPE_UNKNOWN;
+  }
+
+  bool
+  ContainerIndex::GetFileStatus(std::string filename, int64_t* size, int64_t* modificationTime)
+  {
+    struct stat fileStatus;
+    if (stat(filename.c_str(), &fileStatus) != 0)
+      {
+        return false;
+      }
+
+    *size = fileStatus.st_size;
+    *modificationTime = fileStatus.st_mtime;
+    return true;
+  }
+
+  bool
+  ContainerIndex::Load(std::string indexFilename, std::string mediaFilename)
+  {
+    int64_t mediaSize = 0, mediaModificationTime = 0;
+    if (!GetFileStatus(mediaFilename, &mediaSize, &mediaModificationTime))
+      {
+        return false;
+      }
+
+    FILE* indexFile = fopen(indexFilename.c_str(), "rb");
+    if (indexFile == NULL)
+      {
+        return false;
+      }
+
+    /* The whole index is read at once */
+    std::vector<uint8_t> content;
+    uint8_t readBuffer[65536];
+    size_t readBytes = 0;
+    while ((readBytes = fread(readBuffer, 1, sizeof(readBuffer), indexFile)) > 0)
+      {
+        content.insert(content.end(), readBuffer, readBuffer + readBytes);
+      }
+    fclose(indexFile);
+
+    /* Header: magic, version, size and modification time of the media file */
+    uint32_t magic = 0, version = 0, entryCount = 0;
+    int64_t indexedSize = 0, indexedModificationTime = 0;
+    size_t headerSize = 2 * sizeof(uint32_t) + 2 * sizeof(int64_t) + sizeof(StreamParameters);
+    if (content.size() < headerSize)
+      {
+        return false;
+      }
+
+    size_t offset = 0;
+    memcpy(&magic, &content[offset], sizeof(magic));
+    offset += sizeof(magic);
+    memcpy(&version, &content[offset], sizeof(version));
+    offset += sizeof(version);
+    memcpy(&indexedSize, &content[offset], sizeof(indexedSize));
+    offset += sizeof(indexedSize);
+    memcpy(&indexedModificationTime, &content[offset], sizeof(indexedModificationTime));
+    offset += sizeof(indexedModificationTime);
+
+    if (magic != _CONTAINER_INDEX_MAGIC || version != _CONTAINER_INDEX_VERSION ||
+        indexedSize != mediaSize || indexedModificationTime != mediaModificationTime)
+      {
+        std::cout << "ContainerIndex: index " << indexFilename << " is out of date\n";
+        return false;
+      }
+
+    /* Stream parameters, extradata and entries */
+    memcpy(&m_parameters, &content[offset], sizeof(m_parameters));
+    offset += sizeof(m_parameters);
+
+    if (m_parameters.m_extradataSize < 0 ||
+        content.size() < offset + m_parameters.m_extradataSize + sizeof(entryCount))
+      {
+        std::cout << "ContainerIndex: index " << indexFilename << " is corrupted\n";
+        return false;
+      }
+
+    m_extradata.assign(content.begin() + offset,
+                       content.begin() + offset + m_parameters.m_extradataSize);
+    m_extradata.resize(m_parameters.m_extradataSize + FF_INPUT_BUFFER_PADDING_SIZE, 0);
+    offset += m_parameters.m_extradataSize;
+
+    memcpy(&entryCount, &content[offset], sizeof(entryCount));
+    offset += sizeof(entryCount);
+
+    if (content.size() != offset + entryCount * sizeof(IndexEntry))
+      {
+        std::cout << "ContainerIndex: index " << indexFilename << " is corrupted\n";
+        return false;
+      }
+
+    m_entries.resize(entryCount);
+    if (entryCount > 0)
+      {
+        memcpy(&m_entries[0], &content[offset], entryCount * sizeof(IndexEntry));
+      }
+
+    return true;
+  }
+
+  bool
+  ContainerIndex::Save(std::string indexFilename, std::string mediaFilename)
+  {
+    int64_t mediaSize = 0, mediaModificationTime = 0;
+    if (!GetFileStatus(mediaFilename, &mediaSize, &mediaModificationTime))
+      {
+        return false;
+      }
+
+    FILE* indexFile = fopen(indexFilename.c_str(), "wb");
+    if (indexFile == NULL)
+      {
+        std::cout << "ContainerIndex: Cannot write index " << indexFilename << "\n";
+        return false;
+      }
+
+    uint32_t magic = _CONTAINER_INDEX_MAGIC;
+    uint32_t version = _CONTAINER_INDEX_VERSION;
+    uint32_t entryCount = m_entries.size();
+
+    fwrite(&magic, sizeof(magic), 1, indexFile);
+    fwrite(&version, sizeof(version), 1, indexFile);
+    fwrite(&mediaSize, sizeof(mediaSize), 1, indexFile);
+    fwrite(&mediaModificationTime, sizeof(mediaModificationTime), 1, indexFile);
+    fwrite(&m_parameters, sizeof(m_parameters), 1, indexFile);
+    if (m_parameters.m_extradataSize > 0)
+      {
+        fwrite(&m_extradata[0], 1, m_parameters.m_extradataSize, indexFile);
+      }
+    fwrite(&entryCount, sizeof(entryCount), 1, indexFile);
+    if (entryCount > 0)
+      {
+        fwrite(&m_entries[0], sizeof(IndexEntry), entryCount, indexFile);
+      }
+
+    bool result = (ferror(indexFile) == 0);
+    fclose(indexFile);
+
+    return result;
+  }
+
+  void
+  ContainerIndex::StoreStreamParameters(AVStream* stream, int streamNumber)
+  {
+    AVCodecContext* codecContext = stream->codec;
+
+    memset(&m_parameters, 0, sizeof(m_parameters));
+    m_parameters.m_streamNumber = streamNumber;
+    m_parameters.m_streamId = stream->id;
+
+    m_parameters.m_codecId = codecContext->codec_id;
+    m_parameters.m_codecType = codecContext->codec_type;
+    m_parameters.m_codecTag = codecContext->codec_tag;
+    m_parameters.m_bitRate = codecContext->bit_rate;
+    m_parameters.m_width = codecContext->width;
+    m_parameters.m_height = codecContext->height;
+    m_parameters.m_pixelFormat = codecContext->pix_fmt;
+    m_parameters.m_profile = codecContext->profile;
+    m_parameters.m_level = codecContext->level;
+    m_parameters.m_hasBFrames = codecContext->has_b_frames;
+    m_parameters.m_references = codecContext->refs;
+    m_parameters.m_sampleRate = codecContext->sample_rate;
+    m_parameters.m_channels = codecContext->channels;
+    m_parameters.m_channelLayout = codecContext->channel_layout;
+    m_parameters.m_sampleFormat = codecContext->sample_fmt;
+    m_parameters.m_frameSize = codecContext->frame_size;
+    m_parameters.m_blockAlign = codecContext->block_align;
+    m_parameters.m_bitsPerCodedSample = codecContext->bits_per_coded_sample;
+    m_parameters.m_bitsPerRawSample = codecContext->bits_per_raw_sample;
+    m_parameters.m_ticksPerFrame = codecContext->ticks_per_frame;
+    m_parameters.m_codecTimeBaseNum = codecContext->time_base.num;
+    m_parameters.m_codecTimeBaseDen = codecContext->time_base.den;
+    m_parameters.m_codecAspectRatioNum = codecContext->sample_aspect_ratio.num;
+    m_parameters.m_codecAspectRatioDen = codecContext->sample_aspect_ratio.den;
+
+    m_parameters.m_streamTimeBaseNum = stream->time_base.num;
+    m_parameters.m_streamTimeBaseDen = stream->time_base.den;
+    m_parameters.m_realFrameRateNum = stream->r_frame_rate.num;
+    m_parameters.m_realFrameRateDen = stream->r_frame_rate.den;
+    m_parameters.m_averageFrameRateNum = stream->avg_frame_rate.num;
+    m_parameters.m_averageFrameRateDen = stream->avg_frame_rate.den;
+    m_parameters.m_streamAspectRatioNum = stream->sample_aspect_ratio.num;
+    m_parameters.m_streamAspectRatioDen = stream->sample_aspect_ratio.den;
+    m_parameters.m_startTime = stream->start_time;
+    m_parameters.m_duration = stream->duration;
+    m_parameters.m_frameCount = stream->nb_frames;
+    m_parameters.m_ptsValue = stream->pts.val;
+    m_parameters.m_ptsNum = stream->pts.num;
+    m_parameters.m_ptsDen = stream->pts.den;
+
+    /* The extradata carries, e.g., the H.264 parameter sets of mp4 files */
+    m_extradata.clear();
+    if (codecContext->extradata != NULL && codecContext->extradata_size > 0)
+      {
+        m_extradata.assign(codecContext->extradata,
+                           codecContext->extradata + codecContext->extradata_size);
+      }
+    m_parameters.m_extradataSize = m_extradata.size();
+    m_extradata.resize(m_parameters.m_extradataSize + FF_INPUT_BUFFER_PADDING_SIZE, 0);
+  }
+
+  void
+  ContainerIndex::RestoreStreamParameters(AVCodecContext* codecContext, AVStream* stream)
+  {
+    /* The fields which are not stored keep the libav defaults, as after probing */
+    avcodec_get_context_defaults3(codecContext, NULL);
+    memset(stream, 0, sizeof(AVStream));
+
+    codecContext->codec_id = (enum CodecID) m_parameters.m_codecId;
+    codecContext->codec_type = (enum AVMediaType) m_parameters.m_codecType;
+    codecContext->codec_tag = m_parameters.m_codecTag;
+    codecContext->bit_rate = m_parameters.m_bitRate;
+    codecContext->width = m_parameters.m_width;
+    codecContext->height = m_parameters.m_height;
+    codecContext->pix_fmt = (enum PixelFormat) m_parameters.m_pixelFormat;
+    codecContext->profile = m_parameters.m_profile;
+    codecContext->level = m_parameters.m_level;
+    codecContext->has_b_frames = m_parameters.m_hasBFrames;
+    codecContext->refs = m_parameters.m_references;
+    codecContext->sample_rate = m_parameters.m_sampleRate;
+    codecContext->channels = m_parameters.m_channels;
+    codecContext->channel_layout = m_parameters.m_channelLayout;
+    codecContext->sample_fmt = (enum SampleFormat) m_parameters.m_sampleFormat;
+    codecContext->frame_size = m_parameters.m_frameSize;
+    codecContext->block_align = m_parameters.m_blockAlign;
+    codecContext->bits_per_coded_sample = m_parameters.m_bitsPerCodedSample;
+    codecContext->bits_per_raw_sample = m_parameters.m_bitsPerRawSample;
+    codecContext->ticks_per_frame = m_parameters.m_ticksPerFrame;
+    codecContext->time_base.num = m_parameters.m_codecTimeBaseNum;
+    codecContext->time_base.den = m_parameters.m_codecTimeBaseDen;
+    codecContext->sample_aspect_ratio.num = m_parameters.m_codecAspectRatioNum;
+    codecContext->sample_aspect_ratio.den = m_parameters.m_codecAspectRatioDen;
+
+    /* The extradata is owned by the index */
+    if (m_parameters.m_extradataSize > 0)
+      {
+        codecContext->extradata = &m_extradata[0];
+        codecContext->extradata_size = m_parameters.m_extradataSize;
+      }
+
+    stream->index = m_parameters.m_streamNumber;
+    stream->id = m_parameters.m_streamId;
+    stream->codec = codecContext;
+    stream->time_base.num = m_parameters.m_streamTimeBaseNum;
+    stream->time_base.den = m_parameters.m_streamTimeBaseDen;
+    stream->r_frame_rate.num = m_parameters.m_realFrameRateNum;
+    stream->r_frame_rate.den = m_parameters.m_realFrameRateDen;
+    stream->avg_frame_rate.num = m_parameters.m_averageFrameRateNum;
+    stream->avg_frame_rate.den = m_parameters.m_averageFrameRateDen;
+    stream->sample_aspect_ratio.num = m_parameters.m_streamAspectRatioNum;
+    stream->sample_aspect_ratio.den = m_parameters.m_streamAspectRatioDen;
+    stream->start_time = m_parameters.m_startTime;
+    stream->duration = m_parameters.m_duration;
+    stream->nb_frames = m_parameters.m_frameCount;
+    stream->pts.val = m_parameters.m_ptsValue;
+    stream->pts.num = m_parameters.m_ptsNum;
+    stream->pts.den = m_parameters.m_ptsDen;
+  }
+
+  int
+  ContainerIndex::GetStreamNumber()
+  {
+    return m_parameters.m_streamNumber;
+  }
+
+  enum AVMediaType
+  ContainerIndex::GetCodecType()
+  {
+    return (enum AVMediaType) m_parameters.m_codecType;
+  }
+
+  void
+  ContainerIndex::PushBackEntry(IndexEntry entry)
+  {
+    m_entries.push_back(entry);
+  }
+
+  unsigned int
+  ContainerIndex::GetEntryCount()
+  {
+    return m_entries.size();
+  }
+
+  const ContainerIndex::IndexEntry&
+  ContainerIndex::GetEntry(unsigned int entryNumber)
+  {
+    return m_entries[entryNumber];
+  }
+
+  void
+  ContainerIndex::Clear()
+  {
+    m_entries.clear();
+    m_extradata.clear();
+    memset(&m_parameters, 0, sizeof(m_parameters));
+    m_parameters.m_streamNumber = -1;
+    m_parameters.m_codecType = AVMEDIA_TYPE_UNKNOWN;
+  }
+
+} // namespace ns3
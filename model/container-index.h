@@ -0,0 +1,150 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Alessandro Paganelli <alessandro.paganelli@unimore.it>
+ *          Daniela Saladino <daniela.saladino@unimore.it>
+ */
+
+
+#ifndef CONTAINER_INDEX_H_
+#define CONTAINER_INDEX_H_
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <iostream>
+#include "stdint.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/mathematics.h>
+}
+#endif
+
+namespace ns3
+{
+
+  /* Persistent packet index of a multimedia file, stored in a sidecar file. It contains
+   * the parameters of the indexed stream (every codec context and stream field read by
+   * the muxers and the packetizers, extradata included) and the position, size,
+   * timestamps and keyframe flag of each of its packets, so that the file can be opened
+   * without probing and its packets can be read directly, without demuxing it.
+   * The index is validated against the size and the modification time of the file. */
+  class ContainerIndex
+  {
+  public:
+    /* Fixed-width row describing a single packet */
+    typedef struct IndexEntry
+    {
+      int64_t m_offset;
+      int64_t m_pts;
+      int64_t m_dts;
+      uint32_t m_size;
+      uint32_t m_keyframe;
+    } IndexEntry;
+
+    ContainerIndex();
+
+    /* Methods used to read/write the index from/to indexFilename. Load fails if the
+     * index is missing, corrupted or out of date with respect to mediaFilename. */
+    bool
+    Load(std::string indexFilename, std::string mediaFilename);
+    bool
+    Save(std::string indexFilename, std::string mediaFilename);
+
+    /* Methods used to store the parameters of the indexed stream and to restore them
+     * into a codec context and a stream, without any probing */
+    void
+    StoreStreamParameters(AVStream* stream, int streamNumber);
+    void
+    RestoreStreamParameters(AVCodecContext* codecContext, AVStream* stream);
+    int
+    GetStreamNumber();
+    enum AVMediaType
+    GetCodecType();
+
+    void
+    PushBackEntry(IndexEntry entry);
+    unsigned int
+    GetEntryCount();
+    const IndexEntry&
+    GetEntry(unsigned int entryNumber);
+    void
+    Clear();
+
+  protected:
+    /* Parameters of the indexed stream, stored as fixed-width fields */
+    typedef struct StreamParameters
+    {
+      int64_t m_streamNumber;
+      int64_t m_streamId;
+      int64_t m_codecId;
+      int64_t m_codecType;
+      int64_t m_codecTag;
+      int64_t m_bitRate;
+      int64_t m_width;
+      int64_t m_height;
+      int64_t m_pixelFormat;
+      int64_t m_profile;
+      int64_t m_level;
+      int64_t m_hasBFrames;
+      int64_t m_references;
+      int64_t m_sampleRate;
+      int64_t m_channels;
+      int64_t m_channelLayout;
+      int64_t m_sampleFormat;
+      int64_t m_frameSize;
+      int64_t m_blockAlign;
+      int64_t m_bitsPerCodedSample;
+      int64_t m_bitsPerRawSample;
+      int64_t m_ticksPerFrame;
+      int64_t m_codecTimeBaseNum;
+      int64_t m_codecTimeBaseDen;
+      int64_t m_codecAspectRatioNum;
+      int64_t m_codecAspectRatioDen;
+      int64_t m_streamTimeBaseNum;
+      int64_t m_streamTimeBaseDen;
+      int64_t m_realFrameRateNum;
+      int64_t m_realFrameRateDen;
+      int64_t m_averageFrameRateNum;
+      int64_t m_averageFrameRateDen;
+      int64_t m_streamAspectRatioNum;
+      int64_t m_streamAspectRatioDen;
+      int64_t m_startTime;
+      int64_t m_duration;
+      int64_t m_frameCount;
+      int64_t m_ptsValue;
+      int64_t m_ptsNum;
+      int64_t m_ptsDen;
+      int64_t m_extradataSize;
+    } StreamParameters;
+
+    StreamParameters m_parameters;
+
+    /* Extradata of the indexed stream, followed by the padding the decoders expect */
+    std::vector<uint8_t> m_extradata;
+    std::vector<IndexEntry> m_entries;
+
+    /* Method used to obtain the size and the modification time of a file */
+    bool
+    GetFileStatus(std::string filename, int64_t* size, int64_t* modificationTime);
+  };
+
+} // namespace ns3
+
+#endif /* CONTAINER_INDEX_H_ */
@@ -17,17 +17,30 @@
  *          Daniela Saladino <daniela.saladino@unimore.it>
  */
 
+#include <algorithm>
 #include "container.h"
 
 #define _CONTAINER_DEBUG 0
 
+/* Polling interval (in ns) used by the read-ahead and writer threads while waiting: the condition
+ * is signaled at every change, so this only bounds the delay of a missed wake-up */
+#define _READ_AHEAD_WAIT_TIMEOUT 1000000
+
+/* Size of the buffer used by the custom I/O contexts */
+#define _MEMORY_IO_BUFFER_SIZE 65536
+
+/* Extension of the sidecar file storing the packet index */
+#define _CONTAINER_INDEX_EXTENSION ".qoeidx"
+
 namespace ns3
 {
 
   Container::Container(std::string filename, enum Mode openMode, enum AVMediaType type) :
+                       m_index(),
                        m_rtpHeaderQueue(),
-                       m_packetizationQueue(),
-                       m_packetLengthQueue()
+                       m_packetizationBuffer(),
+                       m_packetLengthQueue(),
+                       m_scratchBuffer()
   {
     m_filename = filename;
     m_modeOfOperation = openMode;
@@ -47,10 +60,49 @@ namespace ns3
 
     m_timeUnit = 0.0;
     m_streamNumber = -1;
+
+    m_readAhead = NULL;
+
+    m_useIndex = false;
+    m_indexedFile = NULL;
+    m_nextIndexEntry = 0;
+
+    m_memoryBuffer = NULL;
+    m_memoryPosition = 0;
+    m_asyncWrite = NULL;
+    m_customIoContext = NULL;
+
+    m_windowEnabled = false;
+    m_windowStart = 0.0;
+    m_windowDuration = 0.0;
+    m_windowFirstEntry = 0;
+    m_windowEndEntry = 0;
+    m_windowFirstFrame = 0;
+    m_windowBaseTimestamp = 0;
   }
 
   Container::~Container()
   {
+    if (m_readAhead != NULL)
+      {
+        /* Stop the read-ahead thread and release the packets it did not deliver */
+        m_readAhead->m_mutex.Lock();
+        m_readAhead->m_stop = true;
+        m_readAhead->m_mutex.Unlock();
+        m_readAhead->m_roomCondition.SetCondition(true);
+        m_readAhead->m_roomCondition.Signal();
+        m_readAhead->m_thread->Join();
+
+        while (m_readAhead->m_packetQueue.size() > 0)
+          {
+            av_free_packet(&m_readAhead->m_packetQueue.front());
+            m_readAhead->m_packetQueue.pop();
+          }
+
+        delete m_readAhead;
+        m_readAhead = NULL;
+      }
+
     /* The file needs to be closed, if it is not
      * FIXME: verify if this has to be done also for the writing process */
     if (m_fileOpen && m_modeOfOperation == READ)
@@ -63,6 +115,341 @@ namespace ns3
         m_fileOpen = false;
         av_close_input_file(m_outputFormatContext); // Even if looks wrong, the function is that, indeed.
       }
+
+    if (m_indexedFile != NULL)
+      {
+        fclose(m_indexedFile);
+        m_indexedFile = NULL;
+      }
+
+    CloseCustomIo();
+  }
+
+  void
+  Container::SetMemoryBuffer(SegmentedMemoryBuffer* buffer)
+  {
+    m_memoryBuffer = buffer;
+    m_memoryPosition = 0;
+  }
+
+  bool
+  Container::EnableAsyncWrite(unsigned int bufferSize)
+  {
+    if (m_modeOfOperation != WRITE || m_asyncWrite != NULL || m_memoryBuffer != NULL ||
+        bufferSize == 0)
+      {
+        std::cout << "Container: Cannot enable asynchronous write\n";
+        return false;
+      }
+
+    m_asyncWrite = new AsyncWriteState;
+    m_asyncWrite->m_file = NULL;
+    m_asyncWrite->m_bufferSize = bufferSize;
+    m_asyncWrite->m_activeBuffer.reserve(bufferSize);
+    m_asyncWrite->m_writeBuffer.reserve(bufferSize);
+    m_asyncWrite->m_writePending = false;
+    m_asyncWrite->m_stop = false;
+    m_asyncWrite->m_error = false;
+
+    return true;
+  }
+
+  bool
+  Container::UsesCustomIo()
+  {
+    return m_memoryBuffer != NULL || m_asyncWrite != NULL;
+  }
+
+  bool
+  Container::OpenCustomIo(bool write)
+  {
+    if (!UsesCustomIo() || m_customIoContext != NULL)
+      {
+        return false;
+      }
+
+    if (m_asyncWrite != NULL)
+      {
+        /* The file is opened here and written only by the thread */
+        if (!write || (m_asyncWrite->m_file = fopen(m_filename.c_str(), "wb")) == NULL)
+          {
+            return false;
+          }
+
+        m_asyncWrite->m_thread = Create<SystemThread> (MakeCallback(&Container::AsyncWriteLoop, this));
+        m_asyncWrite->m_thread->Start();
+      }
+
+    unsigned char* ioBuffer = (unsigned char*) av_malloc(_MEMORY_IO_BUFFER_SIZE);
+    if (ioBuffer == NULL)
+      {
+        return false;
+      }
+
+    if (m_memoryBuffer != NULL)
+      {
+        m_memoryPosition = 0;
+        m_customIoContext = avio_alloc_context(ioBuffer, _MEMORY_IO_BUFFER_SIZE, write ? 1 : 0,
+                                               this, &Container::MemoryRead,
+                                               &Container::MemoryWrite, &Container::MemorySeek);
+      }
+    else
+      {
+        m_customIoContext = avio_alloc_context(ioBuffer, _MEMORY_IO_BUFFER_SIZE, 1,
+                                               this, NULL,
+                                               &Container::AsyncWrite, &Container::AsyncSeek);
+      }
+
+    if (m_customIoContext == NULL)
+      {
+        av_free(ioBuffer);
+        return false;
+      }
+
+    return true;
+  }
+
+  void
+  Container::CloseCustomIo()
+  {
+    if (m_customIoContext != NULL)
+      {
+        /* The I/O buffer could have been reallocated by libavformat */
+        av_free(m_customIoContext->buffer);
+        av_free(m_customIoContext);
+        m_customIoContext = NULL;
+      }
+
+    if (m_asyncWrite != NULL)
+      {
+        if (m_asyncWrite->m_file != NULL)
+          {
+            /* The remaining data is written, then the thread is stopped */
+            SubmitAsyncBuffer();
+            WaitAsyncIdle();
+
+            m_asyncWrite->m_mutex.Lock();
+            m_asyncWrite->m_stop = true;
+            m_asyncWrite->m_mutex.Unlock();
+            m_asyncWrite->m_submitCondition.SetCondition(true);
+            m_asyncWrite->m_submitCondition.Signal();
+            m_asyncWrite->m_thread->Join();
+
+            fclose(m_asyncWrite->m_file);
+            m_asyncWrite->m_file = NULL;
+
+            if (m_asyncWrite->m_error)
+              {
+                std::cout << "Container: Error while writing " << m_filename << "\n";
+              }
+          }
+
+        delete m_asyncWrite;
+        m_asyncWrite = NULL;
+      }
+  }
+
+  int
+  Container::MemoryRead(void* opaque, uint8_t* data, int length)
+  {
+    Container* container = (Container*) opaque;
+    unsigned int readBytes = container->m_memoryBuffer->ReadAt(container->m_memoryPosition,
+                                                               data, length);
+    container->m_memoryPosition += readBytes;
+
+    /* Zero bytes mean EOF */
+    return readBytes;
+  }
+
+  int
+  Container::MemoryWrite(void* opaque, uint8_t* data, int length)
+  {
+    Container* container = (Container*) opaque;
+    container->m_memoryBuffer->WriteAt(container->m_memoryPosition, data, length);
+    container->m_memoryPosition += length;
+
+    return length;
+  }
+
+  int64_t
+  Container::MemorySeek(void* opaque, int64_t offset, int whence)
+  {
+    Container* container = (Container*) opaque;
+    int64_t size = container->m_memoryBuffer->GetSize();
+
+    if (whence & AVSEEK_SIZE)
+      {
+        return size;
+      }
+
+    int64_t position = 0;
+    switch (whence)
+      {
+      case SEEK_SET:
+        position = offset;
+        break;
+      case SEEK_CUR:
+        position = container->m_memoryPosition + offset;
+        break;
+      case SEEK_END:
+        position = size + offset;
+        break;
+      default:
+        return -1;
+      }
+
+    if (position < 0)
+      {
+        return -1;
+      }
+
+    container->m_memoryPosition = position;
+    return position;
+  }
+
+  int
+  Container::AsyncWrite(void* opaque, uint8_t* data, int length)
+  {
+    Container* container = (Container*) opaque;
+    AsyncWriteState* state = container->m_asyncWrite;
+    int writtenBytes = length;
+
+    while (length > 0)
+      {
+        unsigned int room = state->m_bufferSize - state->m_activeBuffer.size();
+        unsigned int chunk = std::min((unsigned int) length, room);
+
+        state->m_activeBuffer.insert(state->m_activeBuffer.end(), data, data + chunk);
+        data += chunk;
+        length -= chunk;
+
+        if (state->m_activeBuffer.size() >= state->m_bufferSize)
+          {
+            container->SubmitAsyncBuffer();
+          }
+      }
+
+    return state->m_error ? -1 : writtenBytes;
+  }
+
+  int64_t
+  Container::AsyncSeek(void* opaque, int64_t offset, int whence)
+  {
+    Container* container = (Container*) opaque;
+    AsyncWriteState* state = container->m_asyncWrite;
+
+    if (whence & AVSEEK_SIZE)
+      {
+        return -1;
+      }
+
+    /* The muxer goes back to patch what it has already written (e.g., box sizes): all
+     * the pending data is written before moving within the file, which is then safe
+     * since the thread is idle */
+    container->SubmitAsyncBuffer();
+    container->WaitAsyncIdle();
+
+    if (fseeko(state->m_file, offset, whence) != 0)
+      {
+        return -1;
+      }
+
+    return ftello(state->m_file);
+  }
+
+  void
+  Container::SubmitAsyncBuffer()
+  {
+    if (m_asyncWrite->m_activeBuffer.size() == 0)
+      {
+        return;
+      }
+
+    /* Backpressure: if the thread is still writing the other buffer, I wait for it */
+    m_asyncWrite->m_mutex.Lock();
+    WaitUntil(m_asyncWrite->m_mutex, m_asyncWrite->m_idleCondition,
+              &Container::AsyncWriteIsIdle);
+
+    m_asyncWrite->m_activeBuffer.swap(m_asyncWrite->m_writeBuffer);
+    m_asyncWrite->m_writePending = true;
+    m_asyncWrite->m_mutex.Unlock();
+
+    m_asyncWrite->m_submitCondition.SetCondition(true);
+    m_asyncWrite->m_submitCondition.Signal();
+  }
+
+  void
+  Container::WaitAsyncIdle()
+  {
+    m_asyncWrite->m_mutex.Lock();
+    WaitUntil(m_asyncWrite->m_mutex, m_asyncWrite->m_idleCondition,
+              &Container::AsyncWriteIsIdle);
+    m_asyncWrite->m_mutex.Unlock();
+  }
+
+  void
+  Container::AsyncWriteLoop()
+  {
+    while (true)
+      {
+        /* Wait until a buffer has to be written */
+        m_asyncWrite->m_mutex.Lock();
+        WaitUntil(m_asyncWrite->m_mutex, m_asyncWrite->m_submitCondition,
+                  &Container::AsyncWriteHasWork);
+
+        bool writePending = m_asyncWrite->m_writePending;
+        m_asyncWrite->m_mutex.Unlock();
+
+        if (!writePending)
+          {
+            /* Stop requested, and nothing left to write */
+            return;
+          }
+
+        /* The disk write happens outside the critical section */
+        std::vector<uint8_t>& buffer = m_asyncWrite->m_writeBuffer;
+        size_t writtenBytes = fwrite(&buffer[0], 1, buffer.size(), m_asyncWrite->m_file);
+
+        m_asyncWrite->m_mutex.Lock();
+        if (writtenBytes != buffer.size())
+          {
+            m_asyncWrite->m_error = true;
+          }
+        buffer.clear();
+        m_asyncWrite->m_writePending = false;
+        m_asyncWrite->m_mutex.Unlock();
+
+        m_asyncWrite->m_idleCondition.SetCondition(true);
+        m_asyncWrite->m_idleCondition.Signal();
+      }
+  }
+
+  void
+  Container::EnableIndex()
+  {
+    m_useIndex = true;
+  }
+
+  void
+  Container::SetWindow(double startOffset, double duration)
+  {
+    m_windowEnabled = true;
+    m_windowStart = startOffset;
+    m_windowDuration = duration;
+
+    m_useIndex = true;
+  }
+
+  unsigned int
+  Container::GetWindowFirstFrame()
+  {
+    return m_windowFirstFrame;
+  }
+
+  unsigned int
+  Container::GetWindowFrameCount()
+  {
+    return m_windowEndEntry - m_windowFirstEntry;
   }
 
   /* Method used to setup the reading process from the multimedia file */
@@ -72,9 +459,63 @@ namespace ns3
     /* Initialize each output format */
     av_register_all();
 
+    /* With the index, the file needs neither probing nor demuxing */
+    if (m_useIndex && m_modeOfOperation == READ && m_memoryBuffer == NULL)
+      {
+        /* Each media type has its own sidecar, so that the audio and the video
+         * containers of the same file do not overwrite each other's index */
+        std::string indexFilename = m_filename +
+            ((m_codecType == AVMEDIA_TYPE_AUDIO) ? ".audio" : ".video") +
+            _CONTAINER_INDEX_EXTENSION;
+        if (m_index.Load(indexFilename, m_filename) && m_index.GetEntryCount() > 0 &&
+            m_index.GetCodecType() == m_codecType)
+          {
+            return InitFromIndex();
+          }
+
+        /* A missing, out of date or mismatching index is rebuilt */
+        m_index.Clear();
+
+        if (BuildIndex())
+          {
+            m_index.Save(indexFilename, m_filename);
+            return InitFromIndex();
+          }
+
+        /* The file cannot be indexed: I fall back to the demuxer */
+        std::cout << "Container: Cannot index " << m_filename << ", demuxing it\n";
+        m_index.Clear();
+
+        if (m_windowEnabled)
+          {
+            std::cout << "Container: Cannot read a window without the index\n";
+            return false;
+          }
+      }
+
+    return OpenInputHeader();
+  }
+
+  /* Method used to open the input file and to extract the parameters of the stream */
+  bool
+  Container::OpenInputHeader()
+  {
     /* Open input file - FIXME: deprecated */
     int ret = 0;
     m_inputFormatContext = NULL;
+
+    if (m_memoryBuffer != NULL)
+      {
+        /* The demuxer reads from memory through the custom I/O context */
+        m_inputFormatContext = avformat_alloc_context();
+        if (m_inputFormatContext == NULL || !OpenCustomIo(false))
+          {
+            std::cout << "Container: Cannot open input memory buffer\n";
+            return false;
+          }
+        m_inputFormatContext->pb = m_customIoContext;
+      }
+
     if ((ret = avformat_open_input(&m_inputFormatContext, m_filename.c_str(),
          NULL, NULL)) < 0)
       {
@@ -127,6 +568,210 @@ namespace ns3
     return true;
   }
 
+  bool
+  Container::BuildIndex()
+  {
+    AVFormatContext* formatContext = NULL;
+    if (avformat_open_input(&formatContext, m_filename.c_str(), NULL, NULL) < 0)
+      {
+        std::cout << "Container: Cannot open input file\n";
+        return false;
+      }
+
+    if (av_find_stream_info(formatContext) < 0)
+      {
+        std::cout << "Container: Cannot find stream information\n";
+        av_close_input_file(formatContext);
+        return false;
+      }
+
+    int streamNumber = -1;
+    for (unsigned int i = 0; i < formatContext->nb_streams; i++)
+      {
+        if (formatContext->streams[i]->codec->codec_type == m_codecType)
+          {
+            streamNumber = i;
+            break;
+          }
+      }
+
+    if (streamNumber == -1)
+      {
+        av_close_input_file(formatContext);
+        return false;
+      }
+
+    m_index.Clear();
+    m_index.StoreStreamParameters(formatContext->streams[streamNumber], streamNumber);
+
+    /* I demux the whole file once, storing where each packet lies */
+    AVPacket packet;
+    bool indexable = true;
+    while (av_read_frame(formatContext, &packet) >= 0)
+      {
+        if (packet.stream_index == streamNumber)
+          {
+            if (packet.pos < 0)
+              {
+                /* The demuxer does not know the position of the packet in the file */
+                indexable = false;
+                av_free_packet(&packet);
+                break;
+              }
+
+            ContainerIndex::IndexEntry entry;
+            entry.m_offset = packet.pos;
+            entry.m_pts = packet.pts;
+            entry.m_dts = packet.dts;
+            entry.m_size = packet.size;
+            entry.m_keyframe = (packet.flags & AV_PKT_FLAG_KEY) ? 1 : 0;
+            m_index.PushBackEntry(entry);
+          }
+        av_free_packet(&packet);
+      }
+
+    av_close_input_file(formatContext);
+
+    return indexable && m_index.GetEntryCount() > 0;
+  }
+
+  bool
+  Container::InitFromIndex()
+  {
+    m_indexedFile = fopen(m_filename.c_str(), "rb");
+    if (m_indexedFile == NULL)
+      {
+        std::cout << "Container: Cannot open input file\n";
+        return false;
+      }
+
+    /* The stream parameters are restored from the index, without probing the file.
+     * The stream refers to the codec context stored within this container. */
+    m_streamNumber = m_index.GetStreamNumber();
+    m_index.RestoreStreamParameters(&m_inputCodecContext, &m_copyStream);
+
+    m_timeUnit = ((float) m_copyStream.time_base.num) / m_copyStream.time_base.den;
+    m_sampleRate = 1/m_timeUnit;
+
+    m_nextIndexEntry = 0;
+
+    m_windowFirstEntry = 0;
+    m_windowEndEntry = m_index.GetEntryCount();
+    m_windowFirstFrame = 0;
+    m_windowBaseTimestamp = 0;
+
+    if (m_windowEnabled)
+      {
+        return ApplyWindow();
+      }
+
+    return true;
+  }
+
+  bool
+  Container::ApplyWindow()
+  {
+    unsigned int entryCount = m_index.GetEntryCount();
+    int64_t startTimestamp = (int64_t) (m_windowStart / m_timeUnit);
+
+    /* I look for the last keyframe not following the start of the window. Keyframes are
+     * in presentation order, and every audio packet can be decoded on its own. */
+    unsigned int firstEntry = 0;
+    for (unsigned int i = 0; i < entryCount; i++)
+      {
+        const ContainerIndex::IndexEntry& entry = m_index.GetEntry(i);
+        if (entry.m_keyframe || m_codecType == AVMEDIA_TYPE_AUDIO)
+          {
+            if (entry.m_pts > startTimestamp)
+              {
+                break;
+              }
+            firstEntry = i;
+          }
+      }
+
+    /* The window ends at the first packet to be decoded after its end */
+    unsigned int endEntry = entryCount;
+    if (m_windowDuration > 0)
+      {
+        int64_t endTimestamp = (int64_t) ((m_windowStart + m_windowDuration) / m_timeUnit);
+        for (unsigned int i = firstEntry + 1; i < entryCount; i++)
+          {
+            if (m_index.GetEntry(i).m_dts >= endTimestamp)
+              {
+                endEntry = i;
+                break;
+              }
+          }
+      }
+
+    if (firstEntry >= endEntry)
+      {
+        std::cout << "Container: The window is out of the file\n";
+        return false;
+      }
+
+    /* The frames displayed before the window are those presented before its keyframe */
+    int64_t firstTimestamp = m_index.GetEntry(firstEntry).m_pts;
+    m_windowFirstFrame = 0;
+    for (unsigned int i = 0; i < entryCount; i++)
+      {
+        if (m_index.GetEntry(i).m_pts < firstTimestamp)
+          {
+            m_windowFirstFrame++;
+          }
+      }
+
+    m_windowFirstEntry = firstEntry;
+    m_windowEndEntry = endEntry;
+    m_windowBaseTimestamp = m_index.GetEntry(firstEntry).m_dts;
+    m_nextIndexEntry = firstEntry;
+
+#if _CONTAINER_DEBUG
+    std::cout << "Container: window from entry " << m_windowFirstEntry << " to "
+              << m_windowEndEntry << ", first frame " << m_windowFirstFrame << "\n";
+#endif
+
+    return true;
+  }
+
+  bool
+  Container::ReadIndexedPacket(AVPacket* readFrame)
+  {
+    if (m_nextIndexEntry >= m_windowEndEntry)
+      {
+        /* EOF has been reached */
+        fclose(m_indexedFile);
+        m_indexedFile = NULL;
+        return false;
+      }
+
+    const ContainerIndex::IndexEntry& entry = m_index.GetEntry(m_nextIndexEntry);
+
+    if (av_new_packet(readFrame, entry.m_size) < 0)
+      {
+        return false;
+      }
+
+    if (fseeko(m_indexedFile, entry.m_offset, SEEK_SET) != 0 ||
+        fread(readFrame->data, 1, entry.m_size, m_indexedFile) != entry.m_size)
+      {
+        std::cout << "Container: Cannot read indexed packet " << m_nextIndexEntry << "\n";
+        av_free_packet(readFrame);
+        return false;
+      }
+
+    /* Timestamps are rebased to the start of the window */
+    readFrame->pts = entry.m_pts - m_windowBaseTimestamp;
+    readFrame->dts = entry.m_dts - m_windowBaseTimestamp;
+    readFrame->pos = entry.m_offset;
+    readFrame->stream_index = m_streamNumber;
+    readFrame->flags = entry.m_keyframe ? AV_PKT_FLAG_KEY : 0;
+
+    m_nextIndexEntry++;
+    return true;
+  }
+
   /* Function used to read the next packet from the underlying container */
   bool
   Container::GetNextPacket(AVPacket* readFrame)
@@ -137,6 +782,158 @@ namespace ns3
         return false;
       }
 
+    if (m_readAhead == NULL)
+      {
+        return ReadPacket(readFrame);
+      }
+
+    /* Read-ahead mode: the packet is taken from the queue filled by the thread */
+    m_readAhead->m_mutex.Lock();
+    WaitUntil(m_readAhead->m_mutex, m_readAhead->m_packetCondition,
+              &Container::ReadAheadHasPacket);
+
+    if (m_readAhead->m_packetQueue.size() == 0)
+      {
+        /* EOF has been reached */
+        m_readAhead->m_mutex.Unlock();
+        return false;
+      }
+
+    *readFrame = m_readAhead->m_packetQueue.front();
+    m_readAhead->m_packetQueue.pop();
+    m_readAhead->m_mutex.Unlock();
+
+    /* Wake up the thread, since there is room for a new packet */
+    m_readAhead->m_roomCondition.SetCondition(true);
+    m_readAhead->m_roomCondition.Signal();
+
+    return true;
+  }
+
+  bool
+  Container::EnableReadAhead(unsigned int queueLength)
+  {
+    if (m_modeOfOperation != READ || (!m_fileOpen && m_indexedFile == NULL) ||
+        m_readAhead != NULL || queueLength == 0)
+      {
+        std::cout << "Container: Cannot enable read-ahead\n";
+        return false;
+      }
+
+    m_readAhead = new ReadAheadState;
+    m_readAhead->m_queueLength = queueLength;
+    m_readAhead->m_eof = false;
+    m_readAhead->m_stop = false;
+    m_readAhead->m_thread = Create<SystemThread> (MakeCallback(&Container::ReadAheadLoop, this));
+    m_readAhead->m_thread->Start();
+
+    return true;
+  }
+
+  void
+  Container::WaitUntil(SystemMutex& mutex, SystemCondition& condition,
+                       WaitPredicate predicate)
+  {
+    /* SystemCondition does not reset its flag on its own: it is reset here, under mutex,
+     * before the predicate is checked. A state change made after the check is always
+     * followed by SetCondition(true), so TimedWait cannot miss it. */
+    condition.SetCondition(false);
+    while (!(this->*predicate)())
+      {
+        mutex.Unlock();
+        condition.TimedWait(_READ_AHEAD_WAIT_TIMEOUT);
+        mutex.Lock();
+        condition.SetCondition(false);
+      }
+  }
+
+  bool
+  Container::ReadAheadHasPacket()
+  {
+    return m_readAhead->m_packetQueue.size() > 0 || m_readAhead->m_eof;
+  }
+
+  bool
+  Container::ReadAheadHasRoom()
+  {
+    return m_readAhead->m_packetQueue.size() < m_readAhead->m_queueLength ||
+           m_readAhead->m_stop;
+  }
+
+  bool
+  Container::AsyncWriteIsIdle()
+  {
+    return !m_asyncWrite->m_writePending;
+  }
+
+  bool
+  Container::AsyncWriteHasWork()
+  {
+    return m_asyncWrite->m_writePending || m_asyncWrite->m_stop;
+  }
+
+  void
+  Container::ReadAheadLoop()
+  {
+    while (true)
+      {
+        /* Wait until there is room in the queue */
+        m_readAhead->m_mutex.Lock();
+        WaitUntil(m_readAhead->m_mutex, m_readAhead->m_roomCondition,
+                  &Container::ReadAheadHasRoom);
+
+        bool stop = m_readAhead->m_stop;
+        m_readAhead->m_mutex.Unlock();
+
+        if (stop)
+          {
+            return;
+          }
+
+        /* The demux happens outside the critical section. The packet data is
+         * duplicated, since it must outlive the following reads. */
+        AVPacket packet;
+        bool packetRead = ReadPacket(&packet);
+        if (packetRead)
+          {
+            av_dup_packet(&packet);
+          }
+
+        m_readAhead->m_mutex.Lock();
+        if (packetRead)
+          {
+            m_readAhead->m_packetQueue.push(packet);
+          }
+        else
+          {
+            m_readAhead->m_eof = true;
+          }
+        m_readAhead->m_mutex.Unlock();
+
+        m_readAhead->m_packetCondition.SetCondition(true);
+        m_readAhead->m_packetCondition.Signal();
+
+        if (!packetRead)
+          {
+            return;
+          }
+      }
+  }
+
+  bool
+  Container::ReadPacket(AVPacket* readFrame)
+  {
+    if (m_indexedFile != NULL)
+      {
+        return ReadIndexedPacket(readFrame);
+      }
+
+    if (m_index.GetEntryCount() > 0)
+      {
+        /* The indexed file has already been read up to its end */
+        return false;
+      }
+
     /* A new frame has to be read from the file */
     if (m_inputFormatContext->streams == 0)
       {
@@ -153,6 +950,7 @@ namespace ns3
          * The file needs to be closed */
         m_fileOpen = false;
         av_close_input_file(m_inputFormatContext);
+        CloseCustomIo();
 
         return false;
       }
@@ -166,14 +964,40 @@ namespace ns3
     /* At first, I fill the queues with fresh data */
     m_rtpHeaderQueue.push(rtpHeader);
     m_packetLengthQueue.push(length);
+    m_packetizationBuffer.Write(packetData, length);
+
+    /* Now I call the specific (i.e., virtual) packetization function */
+    PacketizeFromQueue();
+  }
+
+  const uint8_t*
+  Container::ReadPacketizationData(unsigned int length)
+  {
+    unsigned int contiguousLength = 0;
+    const uint8_t* data = m_packetizationBuffer.Peek(&contiguousLength);
 
-    for (unsigned int i = 0; i < length; i++)
+    if (contiguousLength >= length)
       {
-        m_packetizationQueue.push(packetData[i]);
+        /* No copy is needed: the bytes are released, but they are not overwritten
+         * until new data is written into the buffer */
+        m_packetizationBuffer.Consume(length);
+        return data;
       }
 
-    /* Now I call the specific (i.e., virtual) packetization function */
-    PacketizeFromQueue();
+    uint8_t* scratch = GetScratchBuffer(length);
+    m_packetizationBuffer.Read(scratch, length);
+    return scratch;
+  }
+
+  uint8_t*
+  Container::GetScratchBuffer(unsigned int length)
+  {
+    if (m_scratchBuffer.size() < length || m_scratchBuffer.empty())
+      {
+        m_scratchBuffer.resize(length > 0 ? length : 1);
+      }
+
+    return &m_scratchBuffer[0];
   }
 
   void
@@ -275,6 +1099,24 @@ namespace ns3
     return m_inputCodecContext;
   }
 
+  unsigned int
+  Container::GetNalLengthSize()
+  {
+    AVCodecContext* codecContext = (m_modeOfOperation == READ) ? &m_inputCodecContext
+                                                                : &m_copyCodecContext;
+
+    /* The avcC configuration record stores the length size minus one in the two least
+     * significant bits of its fifth byte */
+    if (codecContext->extradata != NULL && codecContext->extradata_size >= 5 &&
+        codecContext->extradata[0] == 1)
+      {
+        return (codecContext->extradata[4] & 0x03) + 1;
+      }
+
+    std::cout << "Container: no avcC configuration record, assuming 4 bytes NAL lengths\n";
+    return 4;
+  }
+
   AVStream
   Container::GetStream()
   {
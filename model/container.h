@@ -21,7 +21,16 @@
 #define CONTAINER_H_
 
 #include <queue>
+#include <vector>
 #include "ns3/rtp-protocol.h"
+#include "ns3/byte-ring-buffer.h"
+#include "ns3/container-index.h"
+#include "ns3/segmented-memory-buffer.h"
+#include "ns3/ptr.h"
+#include "ns3/callback.h"
+#include "ns3/system-thread.h"
+#include "ns3/system-mutex.h"
+#include "ns3/system-condition.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -51,12 +60,51 @@ namespace ns3
     ~Container();
 
     /* Method used to initialize the class for reading purposes */
-    bool
+    virtual bool
     InitForRead();
 
     virtual bool
     InitForWrite() = 0;
 
+    /* Method used to enable the packet index: InitForRead loads it from the sidecar
+     * file (filename + ".audio"/".video" + _CONTAINER_INDEX_EXTENSION), or builds and
+     * saves it if it is missing or out of date. The stream parameters are then
+     * restored from the index without probing the file, and packets are read directly
+     * from it without demuxing. It has to be called before InitForRead. */
+    void
+    EnableIndex();
+
+    /* Method used to keep the file in memory instead of the filesystem: the muxer writes
+     * into (and the demuxer reads from) buffer through custom I/O callbacks, and the
+     * filename is only used as a label. The buffer is not owned by the container, so
+     * that it can be shared between a writing and a reading container. It has to be
+     * called before InitForRead/InitForWrite; the packet index is not used. */
+    void
+    SetMemoryBuffer(SegmentedMemoryBuffer* buffer);
+
+    /* Method used to enable the asynchronous output mode: the muxed bytes are collected
+     * into a buffer of bufferSize bytes, which is handed to a writer thread when full
+     * while a second buffer is being filled, so that disk writes do not stall the
+     * simulation. The caller waits only if both buffers are full. It has to be called
+     * before InitForWrite; FinalizeFile flushes all the data and stops the thread. */
+    virtual bool
+    EnableAsyncWrite(unsigned int bufferSize);
+
+    /* Method used to restrict the reading process to the window of duration seconds
+     * starting at startOffset (a zero duration extends it to the end of the file).
+     * Reading starts from the nearest keyframe preceding startOffset, and the
+     * timestamps are rebased to it. The window is served through the packet index,
+     * which is therefore enabled as well. It has to be called before InitForRead. */
+    void
+    SetWindow(double startOffset, double duration);
+
+    /* Methods used to locate the window within the original stream, in frames: the
+     * number of frames displayed before the window and the number of frames in it */
+    unsigned int
+    GetWindowFirstFrame();
+    unsigned int
+    GetWindowFrameCount();
+
     /* Method used to set to the container a new data packet */
     void
     SetNextPacket(RtpProtocol rtpHeader, uint8_t* packetData,
@@ -66,6 +114,12 @@ namespace ns3
     virtual bool
     GetNextPacket(AVPacket* readFrame);
 
+    /* Method used to enable the read-ahead mode: a background thread demuxes the file
+     * into a bounded queue of (at most) queueLength packets, from which GetNextPacket
+     * extracts them. It has to be called after InitForRead. */
+    virtual bool
+    EnableReadAhead(unsigned int queueLength);
+
     virtual bool
     FinalizeFile() = 0;
 
@@ -108,6 +162,12 @@ namespace ns3
     AVStream
     GetStream();
 
+    /* Method used to obtain the size of the length field preceding each NAL unit of an
+     * H.264 stream in AVCC format, read from the avcC configuration record of the
+     * input (READ) or copied (WRITE) codec context. Returns 4 if there is no record. */
+    unsigned int
+    GetNalLengthSize();
+
   protected:
     /* Filename used for input/output */
     std::string m_filename;
@@ -133,6 +193,144 @@ namespace ns3
      * possible use (e.g., to reconstruct the same stream at the receiver side */
     AVStream m_copyStream;
 
+    /* State of the read-ahead mode, allocated only when it is enabled */
+    typedef struct ReadAheadState
+    {
+      Ptr<SystemThread> m_thread;
+      SystemMutex m_mutex;
+      SystemCondition m_packetCondition; /* the reader waits for a packet */
+      SystemCondition m_roomCondition; /* the thread waits for room in the queue */
+      std::queue<AVPacket> m_packetQueue;
+      unsigned int m_queueLength;
+      bool m_eof;
+      bool m_stop;
+    } ReadAheadState;
+
+    ReadAheadState* m_readAhead;
+
+    /* Method used to actually demux the next packet from the file */
+    bool
+    ReadPacket(AVPacket* readFrame);
+
+    /* Packet index state: the index itself, the file it refers to, opened
+     * in indexed mode, and the next entry to be read */
+    bool m_useIndex;
+    ContainerIndex m_index;
+    FILE* m_indexedFile;
+    unsigned int m_nextIndexEntry;
+
+    /* Memory-backed mode state: the buffer and the current position within it */
+    SegmentedMemoryBuffer* m_memoryBuffer;
+    uint64_t m_memoryPosition;
+
+    /* State of the asynchronous output mode, allocated only when it is enabled. The
+     * active buffer is filled by the muxer, the write buffer is being written by the
+     * thread while m_writePending is set. */
+    typedef struct AsyncWriteState
+    {
+      Ptr<SystemThread> m_thread;
+      SystemMutex m_mutex;
+      SystemCondition m_submitCondition; /* the thread waits for a buffer */
+      SystemCondition m_idleCondition; /* the muxer waits for the buffer to be written */
+      FILE* m_file;
+      std::vector<uint8_t> m_activeBuffer;
+      std::vector<uint8_t> m_writeBuffer;
+      unsigned int m_bufferSize;
+      bool m_writePending;
+      bool m_stop;
+      bool m_error;
+    } AsyncWriteState;
+
+    AsyncWriteState* m_asyncWrite;
+
+    /* I/O context used by the memory-backed and asynchronous modes */
+    AVIOContext* m_customIoContext;
+
+    /* Methods used to create and release the custom I/O context */
+    bool
+    UsesCustomIo();
+    bool
+    OpenCustomIo(bool write);
+    void
+    CloseCustomIo();
+
+    /* I/O callbacks of the memory-backed mode; opaque is the container */
+    static int
+    MemoryRead(void* opaque, uint8_t* data, int length);
+    static int
+    MemoryWrite(void* opaque, uint8_t* data, int length);
+    static int64_t
+    MemorySeek(void* opaque, int64_t offset, int whence);
+
+    /* I/O callbacks of the asynchronous mode; opaque is the container */
+    static int
+    AsyncWrite(void* opaque, uint8_t* data, int length);
+    static int64_t
+    AsyncSeek(void* opaque, int64_t offset, int whence);
+
+    /* Methods used to hand the active buffer to the writer thread and to wait until
+     * all the submitted data has been written */
+    void
+    SubmitAsyncBuffer();
+    void
+    WaitAsyncIdle();
+
+    /* Body of the writer thread */
+    void
+    AsyncWriteLoop();
+
+    /* Window state: the requested window, the range of index entries covering it, and
+     * the timestamp subtracted from the packets read within it */
+    bool m_windowEnabled;
+    double m_windowStart;
+    double m_windowDuration;
+    unsigned int m_windowFirstEntry;
+    unsigned int m_windowEndEntry;
+    unsigned int m_windowFirstFrame;
+    int64_t m_windowBaseTimestamp;
+
+    /* Method used to find the index entries covering the window */
+    bool
+    ApplyWindow();
+
+    /* Method used to build the index by demuxing the whole file once */
+    bool
+    BuildIndex();
+
+    /* Method used to open the file and to read the stream parameters from its header */
+    bool
+    OpenInputHeader();
+
+    /* Method used to open the file in indexed mode */
+    bool
+    InitFromIndex();
+
+    /* Method used to read the next packet through the index */
+    bool
+    ReadIndexedPacket(AVPacket* readFrame);
+
+    /* Body of the read-ahead thread */
+    void
+    ReadAheadLoop();
+
+    /* Method used by the read-ahead and asynchronous modes to wait, with mutex locked,
+     * until predicate holds. The condition flag is reset under mutex before each check
+     * of the predicate, so that a wait returns only when the condition has been
+     * signalled after that check (or on timeout). Returns with mutex locked. */
+    typedef bool (Container::*WaitPredicate)();
+    void
+    WaitUntil(SystemMutex& mutex, SystemCondition& condition, WaitPredicate predicate);
+
+    /* Wait predicates, to be evaluated with the mutex of their state locked */
+    bool
+    ReadAheadHasPacket();
+    bool
+    ReadAheadHasRoom();
+    bool
+    AsyncWriteIsIdle();
+    bool
+    AsyncWriteHasWork();
+
     /* Flags used to determine if the copies are available or not */
     bool m_copyCodecContextAvailable;
     bool m_copyStreamAvailable;
@@ -144,8 +342,8 @@ namespace ns3
      * every received packet */
     std::queue<RtpProtocol> m_rtpHeaderQueue;
 
-    /* A byte queue exploitable by the re-packetization process */
-    std::queue<uint8_t> m_packetizationQueue;
+    /* A contiguous byte buffer exploitable by the re-packetization process */
+    ByteRingBuffer m_packetizationBuffer;
 
     /* A queue used to store the lengths of the packets received */
     std::queue<unsigned int> m_packetLengthQueue;
@@ -153,6 +351,22 @@ namespace ns3
     virtual bool
     PacketizeFromQueue() = 0;
 
+    /* Scratch buffer owned by the container, reused by every mux operation and grown
+     * to the largest size requested so far, so that no allocation happens in
+     * steady state. */
+    std::vector<uint8_t> m_scratchBuffer;
+
+    /* Method used to extract length bytes from the packetization buffer. If they are
+     * contiguous, a pointer to them is returned without any copy; otherwise they are
+     * copied into the scratch buffer. The returned data is valid until the next
+     * SetNextPacket call. */
+    const uint8_t*
+    ReadPacketizationData(unsigned int length);
+
+    /* Method used to obtain a scratch buffer of (at least) length bytes */
+    uint8_t*
+    GetScratchBuffer(unsigned int length);
+
     /* Generic container/codec variables */
     float m_timeUnit;
     int m_streamNumber;
@@ -163,6 +377,13 @@ namespace ns3
     int m_bitRate;
     int m_sampleRate;
     int m_channels;
+
+  private:
+    /* The read-ahead and asynchronous output states (and their threads) are owned by
+     * the container, which therefore cannot be copied */
+    Container(const Container&);
+    Container&
+    operator=(const Container&);
   };
 
 }
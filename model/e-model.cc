@@ -0,0 +1,256 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Alessandro Paganelli <alessandro.paganelli@unimore.it>
+ *          Daniela Saladino <daniela.saladino@unimore.it>
+ */
+
+
+#include "e-model.h"
+
+#define _E_MODEL_DEBUG 0
+
+namespace ns3
+{
+
+  EModel::EModel(SimulationDataset* simulationDataset)
+  {
+    m_simulationDataset = simulationDataset;
+
+    m_reportInterval = _E_MODEL_DEFAULT_REPORT_INTERVAL;
+    m_playoutDelay = 0;
+    m_packetizationDelay = _E_MODEL_DEFAULT_PACKETIZATION_DELAY;
+    m_ie = _E_MODEL_DEFAULT_IE;
+    m_bpl = _E_MODEL_DEFAULT_BPL;
+
+    m_started = false;
+    m_lastWasLost = false;
+    m_rFactor = 0;
+    m_mos = 0;
+
+    ResetInterval(0);
+  }
+
+  void
+  EModel::SetReportInterval(double reportInterval)
+  {
+    m_reportInterval = reportInterval;
+  }
+
+  void
+  EModel::SetPlayoutDelay(double playoutDelay)
+  {
+    m_playoutDelay = playoutDelay;
+  }
+
+  void
+  EModel::SetPacketizationDelay(double packetizationDelay)
+  {
+    m_packetizationDelay = packetizationDelay;
+  }
+
+  void
+  EModel::SetEquipmentImpairment(double ie, double bpl)
+  {
+    m_ie = ie;
+    m_bpl = bpl;
+  }
+
+  void
+  EModel::RecordDelay(double networkDelay)
+  {
+    m_delaySum += networkDelay;
+    m_delaySamples++;
+  }
+
+  void
+  EModel::RecordReception()
+  {
+    if (m_lastWasLost)
+      {
+        m_lostToReceived++;
+      }
+
+    m_lastWasLost = false;
+    m_receivedPackets++;
+
+    CheckReport();
+  }
+
+  void
+  EModel::RecordLoss(unsigned int lostPackets)
+  {
+    if (lostPackets == 0)
+      {
+        return;
+      }
+
+    if (!m_lastWasLost)
+      {
+        m_receivedToLost++;
+      }
+
+    m_lastWasLost = true;
+    m_lostPackets += lostPackets;
+
+    CheckReport();
+  }
+
+  void
+  EModel::RecordDiscard()
+  {
+    /* The discarded packet will never reach the file rebuilder, which will then count it
+     * as a lost one: here it is only traced, to avoid counting it twice. */
+    m_discardedPackets++;
+  }
+
+  double
+  EModel::GetRFactor()
+  {
+    return m_rFactor;
+  }
+
+  double
+  EModel::GetMos()
+  {
+    return m_mos;
+  }
+
+  double
+  EModel::ComputeMos(double rFactor)
+  {
+    if (rFactor <= 0)
+      {
+        return 1.0;
+      }
+    else if (rFactor >= 100)
+      {
+        return 4.5;
+      }
+
+    return 1 + 0.035 * rFactor + 7e-6 * rFactor * (rFactor - 60) * (100 - rFactor);
+  }
+
+  void
+  EModel::ResetInterval(double now)
+  {
+    m_intervalStart = now;
+    m_receivedPackets = 0;
+    m_lostPackets = 0;
+    m_discardedPackets = 0;
+    m_delaySum = 0;
+    m_delaySamples = 0;
+    m_receivedToLost = 0;
+    m_lostToReceived = 0;
+  }
+
+  /* Method used to export a new sample once the report interval has elapsed */
+  void
+  EModel::CheckReport()
+  {
+    double now = Simulator::Now().GetSeconds();
+
+    if (!m_started)
+      {
+        /* The first report interval starts with the first packet */
+        m_started = true;
+        m_intervalStart = now;
+      }
+
+    if (now - m_intervalStart < m_reportInterval)
+      {
+        return;
+      }
+
+    Report(now);
+  }
+
+  /* Method used to export the last, possibly partial, report interval */
+  void
+  EModel::Flush()
+  {
+    if (!m_started)
+      {
+        return;
+      }
+
+    Report(Simulator::Now().GetSeconds());
+  }
+
+  /* Method used to export a sample covering the packets of the current interval */
+  void
+  EModel::Report(double now)
+  {
+    unsigned int totalPackets = m_receivedPackets + m_lostPackets;
+    if (totalPackets == 0)
+      {
+        return;
+      }
+
+    /* Packet loss probability (in percent) and burst ratio, i.e., the ratio between
+     * the average burst length and that expected under random loss */
+    double ppl = (100.0 * m_lostPackets) / totalPackets;
+    double burstRatio = 1.0;
+    if (m_receivedPackets > 0 && m_lostPackets > 0)
+      {
+        double p = ((double) m_receivedToLost) / m_receivedPackets;
+        double q = ((double) m_lostToReceived) / m_lostPackets;
+        if (p + q > 0)
+          {
+            burstRatio = 1.0 / (p + q);
+          }
+      }
+
+    /* Effective equipment impairment factor */
+    double ieEff = m_ie + (95 - m_ie) * ppl / (ppl / burstRatio + m_bpl);
+
+    /* Delay impairment factor, based on the mouth-to-ear delay in ms */
+    double averageDelay = 0;
+    if (m_delaySamples > 0)
+      {
+        averageDelay = m_delaySum / m_delaySamples;
+      }
+
+    double oneWayDelay = 1000 * (averageDelay + m_playoutDelay + m_packetizationDelay);
+    double id = 0.024 * oneWayDelay;
+    if (oneWayDelay > 177.3)
+      {
+        id += 0.11 * (oneWayDelay - 177.3);
+      }
+
+    m_rFactor = _E_MODEL_DEFAULT_R0 - id - ieEff;
+    m_mos = ComputeMos(m_rFactor);
+
+    /* Export the sample to the simulation dataset */
+    EModelTraceRow eModelTraceRow;
+    eModelTraceRow.m_time = now;
+    eModelTraceRow.m_packetLoss = ppl;
+    eModelTraceRow.m_burstRatio = burstRatio;
+    eModelTraceRow.m_discardedPackets = m_discardedPackets;
+    eModelTraceRow.m_oneWayDelay = oneWayDelay;
+    eModelTraceRow.m_rFactor = m_rFactor;
+    eModelTraceRow.m_mos = m_mos;
+    m_simulationDataset->PushBackEModelTraceRow(eModelTraceRow);
+
+#if _E_MODEL_DEBUG
+    std::cout << "EModel: R-factor " << m_rFactor << ", MOS " << m_mos
+              << " (loss " << ppl << "%, burst ratio " << burstRatio
+              << ", delay " << oneWayDelay << " ms)\n";
+#endif
+
+    ResetInterval(now);
+  }
+
+} // namespace ns3
@@ -0,0 +1,125 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Alessandro Paganelli <alessandro.paganelli@unimore.it>
+ *          Daniela Saladino <daniela.saladino@unimore.it>
+ */
+
+
+#ifndef E_MODEL_H_
+#define E_MODEL_H_
+
+#include <cmath>
+#include <iostream>
+#include "ns3/simulator.h"
+#include "ns3/nstime.h"
+#include "ns3/simulation-dataset.h"
+#include "ns3/packet-trace-structure.h"
+
+namespace ns3
+{
+
+  /* Default E-model parameters (ITU-T G.107/G.113) for G.711 without packet loss
+   * concealment, and default report interval (in seconds) */
+#define _E_MODEL_DEFAULT_R0 93.2
+#define _E_MODEL_DEFAULT_IE 0.0
+#define _E_MODEL_DEFAULT_BPL 4.3
+#define _E_MODEL_DEFAULT_REPORT_INTERVAL 5.0
+#define _E_MODEL_DEFAULT_PACKETIZATION_DELAY 0.02
+
+  /* Online estimator of the conversational quality of an audio flow, according to the
+   * ITU-T G.107 E-model. It is fed by the receiver (network delay and jitter buffer
+   * discards) and by the file rebuilder (received and lost packets), and periodically
+   * exports an R-factor/MOS sample to the simulation dataset. */
+  class EModel
+  {
+  public:
+    EModel(SimulationDataset* simulationDataset);
+
+    /* Configuration methods. Delays and intervals are expressed in seconds. */
+    void
+    SetReportInterval(double reportInterval);
+    void
+    SetPlayoutDelay(double playoutDelay);
+    void
+    SetPacketizationDelay(double packetizationDelay);
+    void
+    SetEquipmentImpairment(double ie, double bpl);
+
+    /* Methods used to feed the estimator */
+    void
+    RecordDelay(double networkDelay);
+    void
+    RecordReception();
+    void
+    RecordLoss(unsigned int lostPackets);
+    void
+    RecordDiscard();
+
+    /* Method used to export the last interval, even if shorter than the report
+     * interval, at the end of the reception */
+    void
+    Flush();
+
+    /* Values computed at the last report */
+    double
+    GetRFactor();
+    double
+    GetMos();
+
+    /* Conversion from R-factor to MOS, according to ITU-T G.107 Annex B */
+    static double
+    ComputeMos(double rFactor);
+
+  protected:
+    SimulationDataset* m_simulationDataset;
+
+    /* Model parameters */
+    double m_reportInterval;
+    double m_playoutDelay;
+    double m_packetizationDelay;
+    double m_ie;
+    double m_bpl;
+
+    /* Counters referring to the current report interval */
+    bool m_started;
+    double m_intervalStart;
+    unsigned int m_receivedPackets;
+    unsigned int m_lostPackets;
+    unsigned int m_discardedPackets;
+    double m_delaySum;
+    unsigned int m_delaySamples;
+
+    /* Two-state (received/lost) Markov chain transition counters, used to
+     * compute the burst ratio */
+    bool m_lastWasLost;
+    unsigned int m_receivedToLost;
+    unsigned int m_lostToReceived;
+
+    /* Last computed values */
+    double m_rFactor;
+    double m_mos;
+
+    void
+    CheckReport();
+    void
+    Report(double now);
+    void
+    ResetInterval(double now);
+  };
+
+} // namespace ns3
+
+#endif /* E_MODEL_H_ */
@@ -25,9 +25,6 @@
 #include "packetizer.h"
 
 #define _H264_DEBUG 0
-#define _IP_HEADER_LENGTH 20
-#define _UDP_HEADER_LENGTH 8
-#define _RTP_HEADER_LENGTH 12
 
 namespace ns3
 {
@@ -42,10 +39,52 @@ namespace ns3
                    m_packetizationQueue(),
                    m_timestampQueue()
   {
+    m_sourceContainer = NULL;
+    m_nalLengthSize = 0;
+    m_aggregationStart = 0;
+    m_aggregatedNalCount = 0;
+    m_aggregatedNri = 0;
+    m_firstAggregatedNal = NULL;
+    m_firstAggregatedNalSize = 0;
+
+    if (simulationDataset->GetUseContainerIndex())
+      {
+        m_mpeg4Container.EnableIndex();
+      }
+    if (simulationDataset->GetSourceWindowEnabled())
+      {
+        m_mpeg4Container.SetWindow(simulationDataset->GetSourceWindowStart(),
+                                   simulationDataset->GetSourceWindowDuration());
+      }
     m_mpeg4Container.InitForRead();
     m_samplingInterval = m_mpeg4Container.GetSamplingInterval();
   }
 
+  H264Packetizer::H264Packetizer(int mtu,
+                   SimulationDataset* simulationDataset, Container* sourceContainer) :
+                   Packetizer(mtu, simulationDataset),
+                   m_mpeg4Container(simulationDataset->GetOriginalCodedFile(),
+                                    Container::READ, AVMEDIA_TYPE_VIDEO),
+                   m_packetizationQueue(),
+                   m_timestampQueue()
+  {
+    /* The own container is left unopened */
+    m_sourceContainer = sourceContainer;
+    m_nalLengthSize = 0;
+    m_aggregationStart = 0;
+    m_aggregatedNalCount = 0;
+    m_aggregatedNri = 0;
+    m_firstAggregatedNal = NULL;
+    m_firstAggregatedNalSize = 0;
+    m_samplingInterval = m_sourceContainer->GetSamplingInterval();
+  }
+
+  bool
+  H264Packetizer::EnableReadAhead(unsigned int queueLength)
+  {
+    return GetSourceContainer()->EnableReadAhead(queueLength);
+  }
+
   bool
   H264Packetizer::GetNextPacket(Ptr<Packet>& packet)
   {
@@ -61,7 +100,7 @@ namespace ns3
       {
         /* No fragment(s) present. A packet must be read from the container */
         AVPacket readFrame;
-        if (!m_mpeg4Container.GetNextPacket(&readFrame))
+        if (!GetSourceContainer()->GetNextPacket(&readFrame))
           {
             /* EOF has been reached */
             return false;
@@ -69,9 +108,27 @@ namespace ns3
 
         /* Check over the size of the packet */
         assert(readFrame.size > 0);
+
+        if (m_simulationDataset->GetNalAwarePacketization())
+          {
+            /* RFC 6184 packetization of the NAL units of the access unit */
+            PacketizeAccessUnit(&readFrame);
+            av_free_packet(&readFrame);
+
+            if (m_fragmentsQueue.size() == 0)
+              {
+                /* Nothing to be sent for this access unit, I move to the next one */
+                return GetNextPacket(packet);
+              }
+
+            packet = m_fragmentsQueue.front();
+            m_fragmentsQueue.pop();
+
+            return true;
+          }
+
         unsigned int currentFrameSize = (unsigned int) readFrame.size;
-        if (currentFrameSize + _IP_HEADER_LENGTH + _UDP_HEADER_LENGTH +
-            _RTP_HEADER_LENGTH + 1 > m_mtu)
+        if (currentFrameSize + 1 > GetPayloadBudget())
           {
             /* FRAGMENT packet */
             CreateFragments(&readFrame);
@@ -96,35 +153,17 @@ namespace ns3
             currentRow.m_rtpTimestamp = readFrame.dts; // FIXME: check if it is the dts or pts
             currentRow.m_numberOfFragments = 1;
 
-            /* Check the size of the packet trace: if it is zero, this means that no packet
-             * has been traced yet. */
-            unsigned int currentPacketTraceSize =
-                (unsigned int) m_simulationDataset->GetPacketTrace().size();
-
-            if (currentPacketTraceSize == 0)
-              {
-                currentRow.m_packetId = 0;
-              }
-            else
-              {
-                currentRow.m_packetId
-                    = (m_simulationDataset->GetPacketTrace().back()).m_packetId + 1;
-              }
-
-            /* Push back the trace row */
-            m_simulationDataset->PushBackPacketTraceRow(currentRow);
+            /* Push back the trace row, obtaining its packet ID */
+            currentRow.m_packetId = m_simulationDataset->AppendPacketTraceRow(currentRow);
 
-            /* Now I create the packet */
-            packet = Create<Packet> (readFrame.data, readFrame.size);
-
-            /* I create the NAL Unit Header */
+            /* Now I create the packet, with its NAL Unit Header */
             NalUnitHeader nalHeader(0x00, NalUnitHeader::NAL_UNIT);
-            packet->AddHeader(nalHeader);
+            packet = CreatePayloadPacket(currentRow.m_packetId, nalHeader, NULL,
+                                         readFrame.data, readFrame.size);
 
-            /* I create the RTP header
-             * FIXME: currently I fix the synch. source always to 0 */
+            /* I create the RTP header */
             RtpProtocol rtpHeader(RtpProtocol::UNSPECIFIED, currentRow.m_packetId,
-                                  currentRow.m_rtpTimestamp, 0);
+                                  currentRow.m_rtpTimestamp, m_synchronizationSource);
             packet->AddHeader(rtpHeader);
 
 #if _H264_PACKETIZER_DEBUG
@@ -140,6 +179,240 @@ namespace ns3
       }
   }
 
+  unsigned int
+  H264Packetizer::GetNalLengthSize()
+  {
+    if (m_nalLengthSize == 0)
+      {
+        m_nalLengthSize = GetSourceContainer()->GetNalLengthSize();
+      }
+
+    return m_nalLengthSize;
+  }
+
+  void
+  H264Packetizer::PacketizeAccessUnit(AVPacket* frame)
+  {
+    unsigned int lengthSize = GetNalLengthSize();
+    unsigned int frameSize = (unsigned int) frame->size;
+
+    /* Bytes available for the RTP payload of each packet */
+    unsigned int payloadBudget = GetPayloadBudget();
+    assert(payloadBudget > 2);
+
+    std::vector<PayloadDescription> payloads;
+    m_aggregationBuffer.clear();
+    m_aggregationStart = 0;
+    unsigned int offset = 0;
+
+    while (offset + lengthSize <= frameSize)
+      {
+        unsigned int nalSize = 0;
+        for (unsigned int i = 0; i < lengthSize; i++)
+          {
+            nalSize = (nalSize << 8) | frame->data[offset + i];
+          }
+        offset += lengthSize;
+
+        if (nalSize == 0 || nalSize > frameSize - offset)
+          {
+            std::cout << "H264Packetizer: malformed NAL unit length, dropping the rest of the access unit\n";
+            break;
+          }
+
+        const uint8_t* nal = &frame->data[offset];
+        offset += nalSize;
+
+        /* A STAP-A packet carries its own NAL unit header, plus a 16 bit size
+         * field before each aggregated NAL unit */
+        if (1 + 2 + nalSize <= payloadBudget)
+          {
+            if (m_aggregatedNalCount > 0 &&
+                1 + (m_aggregationBuffer.size() - m_aggregationStart) + 2 + nalSize >
+                payloadBudget)
+              {
+                FlushAggregationPacket(payloads);
+              }
+
+            if (m_aggregatedNalCount == 0)
+              {
+                m_firstAggregatedNal = nal;
+                m_firstAggregatedNalSize = nalSize;
+              }
+
+            m_aggregationBuffer.push_back((nalSize >> 8) & 0xFF);
+            m_aggregationBuffer.push_back(nalSize & 0xFF);
+            m_aggregationBuffer.insert(m_aggregationBuffer.end(), nal, nal + nalSize);
+
+            uint8_t nri = (nal[0] >> 5) & 0x03;
+            if (nri > m_aggregatedNri)
+              {
+                m_aggregatedNri = nri;
+              }
+            m_aggregatedNalCount++;
+          }
+        else
+          {
+            FlushAggregationPacket(payloads);
+
+            if (nalSize <= payloadBudget)
+              {
+                AppendSingleNalUnit(payloads, nal, nalSize);
+              }
+            else
+              {
+                AppendFragmentedNalUnit(payloads, nal, nalSize, payloadBudget);
+              }
+          }
+      }
+
+    FlushAggregationPacket(payloads);
+
+    /* Now I know how many packets the access unit has been split into: I fill the
+     * packet trace, create the packets and add the RTP headers. All the packets share
+     * the same timestamp, and the marker bit is set on the last one. */
+    for (unsigned int i = 0; i < payloads.size(); i++)
+      {
+        const PayloadDescription& payload = payloads[i];
+        PacketTraceRow currentRow;
+
+        currentRow.m_packetSize = payload.m_nalHeader.GetSerializedSize() + payload.m_size;
+        if (payload.m_fragmented)
+          {
+            currentRow.m_packetSize += payload.m_fuHeader.GetSerializedSize();
+          }
+        currentRow.m_playbackTimestamp = frame->pts * m_samplingInterval;
+        currentRow.m_decodingTimestamp = frame->dts * m_samplingInterval;
+        currentRow.m_rtpTimestamp = frame->dts;
+        currentRow.m_numberOfFragments = payloads.size();
+
+        currentRow.m_packetId = m_simulationDataset->AppendPacketTraceRow(currentRow);
+
+        const uint8_t* data = payload.m_aggregated ?
+            &m_aggregationBuffer[payload.m_aggregationOffset] : payload.m_data;
+        Ptr<Packet> packet = CreatePayloadPacket(currentRow.m_packetId, payload.m_nalHeader,
+                                                 payload.m_fragmented ? &payload.m_fuHeader : NULL,
+                                                 data, payload.m_size);
+
+        RtpProtocol rtpHeader(RtpProtocol::UNSPECIFIED, currentRow.m_packetId,
+                              currentRow.m_rtpTimestamp, m_synchronizationSource);
+        rtpHeader.SetMarker(i == payloads.size() - 1);
+        packet->AddHeader(rtpHeader);
+
+        m_fragmentsQueue.push(packet);
+
+#if _H264_PACKETIZER_DEBUG
+        std::cout << "H264 packetizer data - packetId: " << currentRow.m_packetId
+                  << ", timestamp: " << currentRow.m_rtpTimestamp
+                  << ", packet size: " << currentRow.m_packetSize << " ("
+                  << (i + 1) << "/" << payloads.size() << ")\n";
+#endif
+      }
+  }
+
+  void
+  H264Packetizer::AppendSingleNalUnit(std::vector<PayloadDescription>& payloads, const uint8_t* nal,
+                                      unsigned int nalSize)
+  {
+    /* The original NAL unit header is reused as the RTP payload header */
+    PayloadDescription payload;
+    payload.m_nalHeader = NalUnitHeader((nal[0] >> 5) & 0x03,
+                                        (NalUnitHeader::NalUnitType) (nal[0] & 0x1F));
+    payload.m_fragmented = false;
+    payload.m_aggregated = false;
+    payload.m_data = nal + 1;
+    payload.m_aggregationOffset = 0;
+    payload.m_size = nalSize - 1;
+
+    payloads.push_back(payload);
+  }
+
+  void
+  H264Packetizer::AppendFragmentedNalUnit(std::vector<PayloadDescription>& payloads,
+                                          const uint8_t* nal, unsigned int nalSize,
+                                          unsigned int payloadBudget)
+  {
+    uint8_t nri = (nal[0] >> 5) & 0x03;
+    uint8_t nalType = nal[0] & 0x1F;
+
+    /* The NAL unit header is not transmitted: the receiver rebuilds it from the FU
+     * indicator and the FU header, which take two bytes of each fragment */
+    unsigned int maxFragmentSize = payloadBudget - 2;
+    unsigned int payloadSize = nalSize - 1;
+
+    /* As in Packetizer::CreateFragments, the NAL unit is split into the minimum number
+     * of fragments of equal size, the first payloadSize % numberOfFragments of them
+     * taking one more byte, instead of leaving a short tail fragment */
+    unsigned int numberOfFragments = (payloadSize + maxFragmentSize - 1) / maxFragmentSize;
+    if (numberOfFragments < 2)
+      {
+        numberOfFragments = 2;
+      }
+    unsigned int baseFragmentSize = payloadSize / numberOfFragments;
+    unsigned int longerFragments = payloadSize % numberOfFragments;
+
+    unsigned int offset = 1;
+    for (unsigned int i = 0; i < numberOfFragments; i++)
+      {
+        unsigned int fragmentSize = baseFragmentSize + ((i < longerFragments) ? 1 : 0);
+
+        FragmentationUnitHeader::FragmentationUnitType fragmentType =
+            FragmentationUnitHeader::UNSPECIFIED;
+        if (i == 0)
+          {
+            fragmentType = FragmentationUnitHeader::START;
+          }
+        else if (i == numberOfFragments - 1)
+          {
+            fragmentType = FragmentationUnitHeader::END;
+          }
+
+        PayloadDescription fragment;
+        fragment.m_nalHeader = NalUnitHeader(nri, NalUnitHeader::FU_A);
+        fragment.m_fragmented = true;
+        fragment.m_fuHeader = FragmentationUnitHeader(fragmentType, nalType);
+        fragment.m_aggregated = false;
+        fragment.m_data = nal + offset;
+        fragment.m_aggregationOffset = 0;
+        fragment.m_size = fragmentSize;
+
+        payloads.push_back(fragment);
+        offset += fragmentSize;
+      }
+  }
+
+  void
+  H264Packetizer::FlushAggregationPacket(std::vector<PayloadDescription>& payloads)
+  {
+    if (m_aggregatedNalCount == 1)
+      {
+        /* Aggregating a single NAL unit would only waste bytes */
+        AppendSingleNalUnit(payloads, m_firstAggregatedNal, m_firstAggregatedNalSize);
+        m_aggregationBuffer.resize(m_aggregationStart);
+      }
+    else if (m_aggregatedNalCount > 1)
+      {
+        /* The data stay in the aggregation buffer, which can still grow: I only keep
+         * their offset */
+        PayloadDescription payload;
+        payload.m_nalHeader = NalUnitHeader(m_aggregatedNri, NalUnitHeader::STAP_A);
+        payload.m_fragmented = false;
+        payload.m_aggregated = true;
+        payload.m_data = NULL;
+        payload.m_aggregationOffset = m_aggregationStart;
+        payload.m_size = m_aggregationBuffer.size() - m_aggregationStart;
+
+        payloads.push_back(payload);
+      }
+
+    m_aggregationStart = m_aggregationBuffer.size();
+    m_aggregationStart = 0;
+    m_aggregatedNalCount = 0;
+    m_aggregatedNri = 0;
+    m_firstAggregatedNal = NULL;
+    m_firstAggregatedNalSize = 0;
+  }
+
   /* This method returns the next packet from the packet queue into buffer. Moreover, it
    * fills the timestamp and the packetId, too.
    * Returns true if everything went well, false otherwise. */
@@ -149,7 +422,7 @@ namespace ns3
   {
     /* A new frame has to be read from the file */
     AVPacket readFrame;
-    if (!m_mpeg4Container.GetNextPacket(&readFrame))
+    if (!GetSourceContainer()->GetNextPacket(&readFrame))
       {
         /* EOF has been reached */
         return false;
@@ -163,8 +436,7 @@ namespace ns3
     *packetSize = readFrame.size;
 
     /* Check if the current packet is smaller than MTU */
-    assert((*packetSize + _IP_HEADER_LENGTH + _UDP_HEADER_LENGTH +
-                          _RTP_HEADER_LENGTH) <= m_mtu);
+    assert(*packetSize <= GetPayloadBudget());
 
     /* Timestamp extraction */
     currentRow.m_playbackTimestamp = readFrame.pts * m_samplingInterval;
@@ -176,29 +448,12 @@ namespace ns3
      * play the output stream! */
     *timestamp = readFrame.pts;
 
-    /* Packet ID */
-    
-    /* Check the size of the packet trace: if it is zero, this means that no packet
-     * has been traced yet. */
-    unsigned int currentPacketTraceSize =
-        (unsigned int) m_simulationDataset->GetPacketTrace().size();
-
-    if (currentPacketTraceSize == 0)
-      {
-        currentRow.m_packetId = 0;
-      }
-    else
-      {
-        currentRow.m_packetId
-            = (m_simulationDataset->GetPacketTrace().back()).m_packetId + 1;
-      }
+    /* Push back the trace row, obtaining its packet ID */
+    currentRow.m_packetId = m_simulationDataset->AppendPacketTraceRow(currentRow);
 
     /* I fill the output packetId */
     *packetId = currentRow.m_packetId;
 
-    /* Push back the trace row */
-    m_simulationDataset->PushBackPacketTraceRow(currentRow);
-
     /* Now I extract exactly readFrame.size bytes from the packet
      * FIXME: I could use memncpy
      * */
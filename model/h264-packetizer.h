@@ -22,6 +22,7 @@
 
 #include <cassert>
 #include <queue>
+#include <vector>
 #include "mpeg4-container.h"
 #include "packetizer.h"
 #include "packet-trace-structure.h"
@@ -39,6 +40,15 @@ namespace ns3
     /* The mpeg4 file container used to read the input file */
     Mpeg4Container m_mpeg4Container;
 
+    /* External container the packets are read from, if any */
+    Container* m_sourceContainer;
+
+    Container*
+    GetSourceContainer()
+    {
+      return (m_sourceContainer != NULL) ? m_sourceContainer : &m_mpeg4Container;
+    }
+
     /* FIXME: Are the following variables useful or not?? */
 
     /* A byte queue exploitable by the packetization process */
@@ -48,9 +58,62 @@ namespace ns3
      * when the actual packetization happens. */
     std::queue<unsigned long int> m_timestampQueue;
 
+    /* Size of the length prefix of each NAL unit within an access unit (AVCC format),
+     * read from the codec extradata the first time it is needed */
+    unsigned int m_nalLengthSize;
+
+    /* Description of an RTP payload of the access unit being packetized: the packets
+     * are created only once all of them are known, i.e., once their packet IDs can be
+     * assigned, so that each payload is written to its final place at once */
+    struct PayloadDescription
+    {
+      NalUnitHeader m_nalHeader;
+      bool m_fragmented;
+      FragmentationUnitHeader m_fuHeader;
+      /* Data of the payload: either a slice of the access unit or, for STAP-A payloads,
+       * m_size bytes of the aggregation buffer starting at m_aggregationOffset */
+      bool m_aggregated;
+      const uint8_t* m_data;
+      unsigned int m_aggregationOffset;
+      unsigned int m_size;
+    };
+
+    /* Buffer used to build the payloads of the STAP-A packets of the access unit; the
+     * packet currently being aggregated starts at m_aggregationStart */
+    std::vector<uint8_t> m_aggregationBuffer;
+    unsigned int m_aggregationStart;
+    unsigned int m_aggregatedNalCount;
+    uint8_t m_aggregatedNri;
+    const uint8_t* m_firstAggregatedNal;
+    unsigned int m_firstAggregatedNalSize;
+
+    unsigned int
+    GetNalLengthSize();
+
+    /* Method used to split an access unit into its NAL units and to packetize them
+     * as described in RFC 6184 (single NAL unit, STAP-A and FU-A packets). All the
+     * resulting packets are pushed, with their RTP header, into the fragments queue. */
+    void
+    PacketizeAccessUnit(AVPacket* frame);
+
+    void
+    AppendSingleNalUnit(std::vector<PayloadDescription>& payloads, const uint8_t* nal,
+                        unsigned int nalSize);
+
+    void
+    AppendFragmentedNalUnit(std::vector<PayloadDescription>& payloads, const uint8_t* nal,
+                            unsigned int nalSize, unsigned int payloadBudget);
+
+    void
+    FlushAggregationPacket(std::vector<PayloadDescription>& payloads);
+
   public:
     H264Packetizer(int mtu, SimulationDataset* simulationDataset);
 
+    /* Constructor used to read the packets from an already initialized container,
+     * e.g., a stream of a MixContainer shared with another packetizer */
+    H264Packetizer(int mtu, SimulationDataset* simulationDataset, Container* sourceContainer);
+
     virtual uint32_t
     GetPayloadLength()
     {
@@ -63,6 +126,9 @@ namespace ns3
 
     virtual bool
     GetNextPacket(Ptr<Packet>& packet);
+
+    virtual bool
+    EnableReadAhead(unsigned int queueLength);
   };
 }
 
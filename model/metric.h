@@ -27,11 +27,31 @@ namespace ns3
   class Metric
   {
   public:
+    Metric()
+    {
+      m_referenceFirstFrame = 0;
+      m_referenceFrameCount = 0;
+    }
+
+    /* Method used to compare the received file only against the window of the original
+     * file starting at firstFrame and made of frameCount frames (zero means up to the
+     * end), e.g., when only a part of the original file has been transmitted */
+    void
+    SetReferenceWindow(unsigned int firstFrame, unsigned int frameCount)
+    {
+      m_referenceFirstFrame = firstFrame;
+      m_referenceFrameCount = frameCount;
+    }
+
     virtual bool 
     EvaluateQoe(std::string originalFilename, std::string receivedFilename) = 0;
   
     virtual bool 
     PrintResults(std::string outputFilename, bool headers) = 0;
+
+  protected:
+    unsigned int m_referenceFirstFrame;
+    unsigned int m_referenceFrameCount;
   };
 }
 
@@ -0,0 +1,467 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Alessandro Paganelli <alessandro.paganelli@unimore.it>
+ *          Daniela Saladino <daniela.saladino@unimore.it>
+ */
+
+
+#include "mix-container.h"
+
+#define _MIX_CONTAINER_DEBUG 0
+
+namespace ns3
+{
+
+  /*************************** MixStreamContainer ***************************/
+
+  MixStreamContainer::MixStreamContainer(MixContainer* parent, enum Mode openMode,
+                                         enum AVMediaType type) :
+                                         Container(parent->m_filename, openMode, type),
+                                         m_pendingPackets()
+  {
+    m_parent = parent;
+    m_outputStreamNumber = -1;
+    m_streamAvailable = false;
+    m_readOpened = false;
+    m_finalized = false;
+    m_copyCodecContextAvailable = false;
+    m_copyStreamAvailable = false;
+  }
+
+  bool
+  MixStreamContainer::InitForRead()
+  {
+    if (m_useIndex || m_windowEnabled)
+      {
+        std::cout << "MixStreamContainer: The index and windows are not supported on a stream\n";
+        return false;
+      }
+
+    m_readOpened = (m_modeOfOperation == READ && m_streamAvailable);
+    return m_readOpened;
+  }
+
+  bool
+  MixStreamContainer::InitForWrite()
+  {
+    return m_modeOfOperation == WRITE && m_outputStreamNumber >= 0;
+  }
+
+  bool
+  MixStreamContainer::EnableReadAhead(unsigned int /* queueLength */)
+  {
+    std::cout << "MixStreamContainer: Read-ahead is not supported on a stream\n";
+    return false;
+  }
+
+  bool
+  MixStreamContainer::EnableAsyncWrite(unsigned int bufferSize)
+  {
+    return m_parent->EnableAsyncWrite(bufferSize);
+  }
+
+  bool
+  MixStreamContainer::GetNextPacket(AVPacket* readFrame)
+  {
+    if (m_modeOfOperation == WRITE || !m_streamAvailable)
+      {
+        return false;
+      }
+
+    return m_parent->ReadStreamPacket(this, readFrame);
+  }
+
+  bool
+  MixStreamContainer::PacketizeFromQueue()
+  {
+    /* As for Mpeg4, it is possible to dequeue exactly one packet per round */
+    unsigned int packetSize = m_packetLengthQueue.front();
+    unsigned int currentTimestamp = m_rtpHeaderQueue.front().GetPacketTimestamp();
+
+    m_rtpHeaderQueue.pop();
+    m_packetLengthQueue.pop();
+
+    AVPacket outputFrame;
+    av_init_packet(&outputFrame);
+
+    outputFrame.size = packetSize;
+    outputFrame.dts = currentTimestamp;
+    outputFrame.pts = currentTimestamp;
+    outputFrame.duration = 0;
+    outputFrame.pos = -1;
+    outputFrame.stream_index = m_outputStreamNumber;
+    outputFrame.data = (uint8_t*) ReadPacketizationData(packetSize);
+
+    if (m_outputStreamNumber < 0 || !m_parent->WriteStreamPacket(&outputFrame))
+      {
+        std::cout << "MixStreamContainer: Error while writing frame\n";
+      }
+
+    av_free_packet(&outputFrame);
+
+    return true;
+  }
+
+  bool
+  MixStreamContainer::FinalizeFile()
+  {
+    if (m_modeOfOperation != WRITE || m_finalized)
+      {
+        return false;
+      }
+
+    m_finalized = true;
+    m_parent->StreamFinalized();
+
+    return true;
+  }
+
+  /****************************** MixContainer ******************************/
+
+  MixContainer::MixContainer(std::string filename, enum Mode openMode) :
+                             Container(filename, openMode, AVMEDIA_TYPE_UNKNOWN)
+  {
+    m_copyCodecContextAvailable = false;
+    m_copyStreamAvailable = false;
+    m_endOfFile = false;
+    m_trailerWritten = false;
+
+    m_videoStream = new MixStreamContainer(this, openMode, AVMEDIA_TYPE_VIDEO);
+    m_audioStream = new MixStreamContainer(this, openMode, AVMEDIA_TYPE_AUDIO);
+  }
+
+  MixContainer::~MixContainer()
+  {
+    MixStreamContainer* streams[2] = { m_videoStream, m_audioStream };
+    for (unsigned int i = 0; i < 2; i++)
+      {
+        /* Release the packets that have not been read */
+        while (streams[i]->m_pendingPackets.size() > 0)
+          {
+            av_free_packet(&streams[i]->m_pendingPackets.front());
+            streams[i]->m_pendingPackets.pop();
+          }
+        delete streams[i];
+      }
+  }
+
+  MixStreamContainer*
+  MixContainer::GetStreamContainer(enum AVMediaType type)
+  {
+    if (type == AVMEDIA_TYPE_VIDEO)
+      {
+        return m_videoStream;
+      }
+    else if (type == AVMEDIA_TYPE_AUDIO)
+      {
+        return m_audioStream;
+      }
+
+    return NULL;
+  }
+
+  bool
+  MixContainer::InitForRead()
+  {
+    if (m_modeOfOperation != READ)
+      {
+        return false;
+      }
+
+    if (m_useIndex || m_windowEnabled)
+      {
+        std::cout << "MixContainer: The index and windows are not supported\n";
+        return false;
+      }
+
+    av_register_all();
+
+    m_inputFormatContext = NULL;
+    if (avformat_open_input(&m_inputFormatContext, m_filename.c_str(), NULL, NULL) < 0)
+      {
+        std::cout << "MixContainer: Cannot open input file\n";
+        return false;
+      }
+    m_fileOpen = true;
+
+    if (av_find_stream_info(m_inputFormatContext) < 0)
+      {
+        std::cout << "MixContainer: Cannot find stream information\n";
+        return false;
+      }
+
+    /* The first stream of each type is routed to the corresponding view */
+    for (unsigned int i = 0; i < m_inputFormatContext->nb_streams; i++)
+      {
+        enum AVMediaType type = m_inputFormatContext->streams[i]->codec->codec_type;
+        MixStreamContainer* stream = GetStreamContainer(type);
+        if (stream != NULL && !stream->m_streamAvailable)
+          {
+            SetupStream(stream, i);
+          }
+      }
+
+    if (!m_videoStream->m_streamAvailable && !m_audioStream->m_streamAvailable)
+      {
+        std::cout << "MixContainer: Cannot find audio or video streams\n";
+        return false;
+      }
+
+    return true;
+  }
+
+  bool
+  MixContainer::EnableReadAhead(unsigned int /* queueLength */)
+  {
+    /* The views read the demuxer directly, which cannot be shared with a thread */
+    std::cout << "MixContainer: Read-ahead is not supported\n";
+    return false;
+  }
+
+  void
+  MixContainer::SetupStream(MixStreamContainer* stream, int streamNumber)
+  {
+    AVStream* inputStream = m_inputFormatContext->streams[streamNumber];
+
+    stream->m_streamNumber = streamNumber;
+    stream->m_timeUnit = ((float) inputStream->time_base.num) / inputStream->time_base.den;
+    stream->m_sampleRate = 1/stream->m_timeUnit;
+    stream->m_inputCodecContext = *(inputStream->codec);
+    stream->m_copyStream = *inputStream;
+    stream->m_streamAvailable = true;
+  }
+
+  bool
+  MixContainer::ReadStreamPacket(MixStreamContainer* stream, AVPacket* readFrame)
+  {
+    if (stream->m_pendingPackets.size() > 0)
+      {
+        *readFrame = stream->m_pendingPackets.front();
+        stream->m_pendingPackets.pop();
+        return true;
+      }
+
+    /* I demux until a packet of the requested stream is found, keeping those of the
+     * other stream for its next read */
+    while (!m_endOfFile)
+      {
+        AVPacket packet;
+        if (!ReadPacket(&packet))
+          {
+            m_endOfFile = true;
+            break;
+          }
+
+        if (packet.stream_index == stream->m_streamNumber)
+          {
+            *readFrame = packet;
+            return true;
+          }
+
+        /* The packets of a view which is not read are dropped */
+        MixStreamContainer* other = (stream == m_videoStream) ? m_audioStream : m_videoStream;
+        if (!other->m_readOpened || packet.stream_index != other->m_streamNumber)
+          {
+            av_free_packet(&packet);
+            continue;
+          }
+
+        /* I never discard the media of a view which is being read: if it lags too far
+         * behind, I stop demuxing and fail the read instead */
+        if (other->m_pendingPackets.size() >= _MIX_CONTAINER_MAX_PENDING_PACKETS)
+          {
+            std::cout << "MixContainer: pending queue of stream " << other->m_streamNumber
+                      << " full, the two views must be read together\n";
+            av_free_packet(&packet);
+            m_endOfFile = true;
+            break;
+          }
+
+        /* The packet data must outlive the following reads */
+        av_dup_packet(&packet);
+        other->m_pendingPackets.push(packet);
+      }
+
+    return false;
+  }
+
+  bool
+  MixContainer::InitForWrite()
+  {
+    if (m_modeOfOperation != WRITE)
+      {
+        return false;
+      }
+
+    /* The output format is chosen according to the file extension */
+    m_outputFormat = av_guess_format(NULL, m_filename.c_str(), NULL);
+    if (!m_outputFormat)
+      {
+        m_outputFormat = av_guess_format("mov", NULL, NULL);
+      }
+
+    if (!m_outputFormat)
+      {
+        std::cout << "MixContainer: no suitable output format found\n";
+        return false;
+      }
+
+    m_outputFormatContext = avformat_alloc_context();
+    if (!m_outputFormatContext)
+      {
+        std::cout << "MixContainer: I could not open the required output format context\n";
+        return false;
+      }
+
+    m_outputFormatContext->oformat = m_outputFormat;
+    snprintf(m_outputFormatContext->filename,
+        sizeof(m_outputFormatContext->filename), "%s", m_filename.c_str());
+
+    /* An output stream for each configured view */
+    MixStreamContainer* streams[2] = { m_videoStream, m_audioStream };
+    for (unsigned int i = 0; i < 2; i++)
+      {
+        MixStreamContainer* stream = streams[i];
+        if (!stream->m_copyCodecContextAvailable || !stream->m_copyStreamAvailable)
+          {
+            continue;
+          }
+
+        AVStream* outputStream = av_new_stream(m_outputFormatContext,
+                                               m_outputFormatContext->nb_streams);
+        if (!outputStream)
+          {
+            std::cout << "MixContainer: I could not allocate the stream\n";
+            return false;
+          }
+
+        if (avcodec_copy_context(outputStream->codec, &stream->m_copyCodecContext))
+          {
+            std::cout << "MixContainer: Codec context copy error! Exit!\n";
+            return false;
+          }
+
+        outputStream->codec->time_base = stream->m_copyStream.time_base;
+        outputStream->sample_aspect_ratio = stream->m_copyStream.sample_aspect_ratio;
+        outputStream->codec->codec_tag = 0;
+
+        if (m_outputFormatContext->flags & AVFMT_GLOBALHEADER)
+          {
+            outputStream->codec->flags |= CODEC_FLAG_GLOBAL_HEADER;
+          }
+
+        stream->m_outputStreamNumber = outputStream->index;
+        stream->m_timeUnit = ((float) stream->m_copyStream.time_base.num) /
+                             stream->m_copyStream.time_base.den;
+      }
+
+    if (m_outputFormatContext->nb_streams == 0)
+      {
+        std::cout << "MixContainer: no stream to be written\n";
+        return false;
+      }
+
+    if (av_set_parameters(m_outputFormatContext, NULL) < 0)
+      {
+        std::cout << "MixContainer: invalid parameters\n";
+        return false;
+      }
+
+    av_dump_format(m_outputFormatContext, 0, m_filename.c_str(), 1);
+
+    if (UsesCustomIo())
+      {
+        if (!OpenCustomIo(true))
+          {
+            std::cout << "MixContainer: Could not open custom output\n";
+            return false;
+          }
+        m_outputFormatContext->pb = m_customIoContext;
+      }
+    else if (!(m_outputFormat->flags & AVFMT_NOFILE))
+      {
+        if (avio_open(&m_outputFormatContext->pb, m_filename.c_str(), AVIO_FLAG_WRITE) < 0)
+          {
+            std::cout << "MixContainer: Could not open output file\n";
+            return false;
+          }
+      }
+
+    m_fileOpen = true;
+
+    av_write_header(m_outputFormatContext);
+
+    return true;
+  }
+
+  bool
+  MixContainer::WriteStreamPacket(AVPacket* packet)
+  {
+    if (!m_fileOpen || m_trailerWritten)
+      {
+        return false;
+      }
+
+    /* Audio and video packets are interleaved by the muxer */
+    return av_interleaved_write_frame(m_outputFormatContext, packet) == 0;
+  }
+
+  void
+  MixContainer::StreamFinalized()
+  {
+    /* The file is finalized once every output stream has been finalized */
+    if ((m_videoStream->m_outputStreamNumber < 0 || m_videoStream->m_finalized) &&
+        (m_audioStream->m_outputStreamNumber < 0 || m_audioStream->m_finalized))
+      {
+        FinalizeFile();
+      }
+  }
+
+  bool
+  MixContainer::FinalizeFile()
+  {
+    if (m_modeOfOperation != WRITE || !m_fileOpen || m_trailerWritten)
+      {
+        return false;
+      }
+
+    av_write_trailer(m_outputFormatContext);
+    m_trailerWritten = true;
+
+    if (UsesCustomIo())
+      {
+        avio_flush(m_outputFormatContext->pb);
+        CloseCustomIo();
+        m_outputFormatContext->pb = NULL;
+        m_fileOpen = false;
+      }
+    else if (!(m_outputFormat->flags & AVFMT_NOFILE))
+      {
+        avio_close(m_outputFormatContext->pb);
+        m_fileOpen = false;
+      }
+
+    return true;
+  }
+
+  bool
+  MixContainer::PacketizeFromQueue()
+  {
+    /* Packets are written through the views */
+    return false;
+  }
+
+}
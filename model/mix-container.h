@@ -0,0 +1,161 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Alessandro Paganelli <alessandro.paganelli@unimore.it>
+ *          Daniela Saladino <daniela.saladino@unimore.it>
+ */
+
+
+#ifndef MIX_CONTAINER_H_
+#define MIX_CONTAINER_H_
+
+#include <vector>
+#include <queue>
+#include "container.h"
+
+namespace ns3
+{
+
+  /* Maximum number of packets kept for a view while another one is being read: when
+   * a view is read much less often than the other one, the mix container stops demuxing
+   * and reports an error instead of growing the queue without bound */
+#define _MIX_CONTAINER_MAX_PENDING_PACKETS 1024
+
+  class MixContainer;
+
+  /* View of a single stream of a MixContainer, usable wherever a Container is expected
+   * (e.g., by a packetizer or by a file rebuilder). Reading extracts the packets of its
+   * stream from the shared demuxer, writing sends them to the shared muxer. */
+  class MixStreamContainer : public ns3::Container
+  {
+  public:
+    MixStreamContainer(MixContainer* parent, enum Mode openMode, enum AVMediaType type);
+
+    /* The file is opened by the parent MixContainer: these methods only report
+     * whether the stream is available. The packets of a stream are kept for its view
+     * only once InitForRead has been called on it, so every view to be read has to
+     * be initialized before the first packet is read from any of them. */
+    virtual bool
+    InitForRead();
+    virtual bool
+    InitForWrite();
+
+    /* Packets are demuxed by the parent and routed to the views, so a view cannot
+     * read ahead, and InitForRead fails if the index or a window has been enabled on
+     * it. The asynchronous output mode is enabled on the parent, which muxes the
+     * packets of all the views. */
+    virtual bool
+    EnableReadAhead(unsigned int queueLength);
+    virtual bool
+    EnableAsyncWrite(unsigned int bufferSize);
+
+    virtual bool
+    GetNextPacket(AVPacket* readFrame);
+
+    /* Method used to signal that no more packets will be written to this stream: the
+     * parent finalizes the file when all its output streams are finalized */
+    virtual bool
+    FinalizeFile();
+
+  protected:
+    virtual bool
+    PacketizeFromQueue();
+
+    MixContainer* m_parent;
+
+    /* Index of the stream within the output file, -1 if it is not written */
+    int m_outputStreamNumber;
+
+    /* Packets demuxed for this stream while looking for another one (at most
+     * _MIX_CONTAINER_MAX_PENDING_PACKETS) */
+    std::queue<AVPacket> m_pendingPackets;
+
+    bool m_streamAvailable;
+    bool m_readOpened;
+    bool m_finalized;
+
+    friend class MixContainer;
+  };
+
+  /* Container for files carrying both an audio and a video stream (MIX file type). In
+   * READ mode the file is demuxed only once, and each packet is routed to the view of its
+   * stream; in WRITE mode the packets of all the views are interleaved into a single
+   * output file, whose format is guessed from its name. */
+  class MixContainer : public ns3::Container
+  {
+  public:
+    MixContainer(std::string filename, enum Mode openMode);
+
+    virtual
+    ~MixContainer();
+
+    /* Method used to open the file and to set up a view for each of its audio and
+     * video streams. The file is always demuxed: the index, windows and read-ahead
+     * are not supported. */
+    virtual bool
+    InitForRead();
+    virtual bool
+    EnableReadAhead(unsigned int queueLength);
+
+    /* Method used to create the output file, with a stream for each view that received
+     * a codec context and a stream through SetCodecContext/SetStream */
+    virtual bool
+    InitForWrite();
+
+    virtual bool
+    FinalizeFile();
+
+    /* Method used to obtain the view of the stream of the given type */
+    MixStreamContainer*
+    GetStreamContainer(enum AVMediaType type);
+
+  protected:
+    virtual bool
+    PacketizeFromQueue();
+
+    /* Views of the video and of the audio stream */
+    MixStreamContainer* m_videoStream;
+    MixStreamContainer* m_audioStream;
+
+    bool m_endOfFile;
+    bool m_trailerWritten;
+
+    /* Method used by the views to read the next packet of their stream */
+    bool
+    ReadStreamPacket(MixStreamContainer* stream, AVPacket* readFrame);
+
+    /* Method used by the views to write a packet to the output file */
+    bool
+    WriteStreamPacket(AVPacket* packet);
+
+    /* Method called by the views when they are finalized */
+    void
+    StreamFinalized();
+
+    void
+    SetupStream(MixStreamContainer* stream, int streamNumber);
+
+    friend class MixStreamContainer;
+
+  private:
+    /* The views are owned by the container, which cannot be copied */
+    MixContainer(const MixContainer&);
+    MixContainer&
+    operator=(const MixContainer&);
+  };
+
+}
+
+#endif /* MIX_CONTAINER_H_ */
@@ -19,6 +19,13 @@
 
 #include "mpeg4-container.h"
 
+#ifdef __cplusplus
+extern "C"
+{
+#include <libavutil/opt.h>
+}
+#endif
+
 namespace ns3
 {
 
@@ -29,6 +36,19 @@ namespace ns3
     m_copyCodecContextAvailable = false;
     m_copyStreamAvailable = false;
     m_lastPts = 0;
+    m_fragmentDuration = 0;
+  }
+
+  void
+  Mpeg4Container::SetFragmentDuration(double fragmentDuration)
+  {
+    m_fragmentDuration = fragmentDuration;
+  }
+
+  double
+  Mpeg4Container::GetFragmentDuration()
+  {
+    return m_fragmentDuration;
   }
 
   bool
@@ -111,9 +131,36 @@ namespace ns3
             return false;
           }
 
+        /* Fragmented output: the muxer options are available only after the private
+         * context has been set up by av_set_parameters */
+        if (m_fragmentDuration > 0)
+          {
+            std::ostringstream fragmentDuration;
+            fragmentDuration << (int64_t) (m_fragmentDuration * AV_TIME_BASE);
+
+            if (av_opt_set(m_outputFormatContext->priv_data, "movflags", "empty_moov", 0) < 0 ||
+                av_opt_set(m_outputFormatContext->priv_data, "frag_duration",
+                           fragmentDuration.str().c_str(), 0) < 0)
+              {
+                std::cout << "Mpeg4Container: fragmented output not supported\n";
+                return false;
+              }
+          }
+
         av_dump_format(m_outputFormatContext, 0, m_filename.c_str(), 1);
 
-        if (!(m_outputFormat->flags & AVFMT_NOFILE))
+        if (UsesCustomIo())
+          {
+            /* The muxer writes into memory, or to the writer thread, through the
+             * custom I/O context */
+            if (!OpenCustomIo(true))
+              {
+                std::cout << "Mpeg4Container: Could not open custom output\n";
+                return false;
+              }
+            m_outputFormatContext->pb = m_customIoContext;
+          }
+        else if (!(m_outputFormat->flags & AVFMT_NOFILE))
           {
             if (avio_open(&m_outputFormatContext->pb, m_filename.c_str(), AVIO_FLAG_WRITE)
                 < 0)
@@ -156,16 +203,7 @@ namespace ns3
     outputFrame.duration = 0;
     outputFrame.pos = -1;
 
-    uint8_t* tempBuffer = (uint8_t*) calloc(packetSize, sizeof(uint8_t));
-    assert(tempBuffer != NULL);
-
-    for (unsigned int i = 0; i < packetSize; i++)
-      {
-        tempBuffer[i] = m_packetizationQueue.front();
-        m_packetizationQueue.pop();
-      }
-
-    outputFrame.data = tempBuffer;
+    outputFrame.data = (uint8_t*) ReadPacketizationData(packetSize);
 
     /* Now I have to export the packet to the output context */
     // if (av_interleaved_write_frame(m_outputFormatContext, &outputFrame) != 0)
@@ -175,7 +213,6 @@ namespace ns3
       }
 
     av_free_packet(&outputFrame);
-    free(tempBuffer);
 
     return true;
   }
@@ -184,7 +221,16 @@ namespace ns3
   Mpeg4Container::FinalizeFile()
   {
     av_write_trailer(m_outputFormatContext);
-    if (!(m_outputFormat->flags & AVFMT_NOFILE))
+    if (UsesCustomIo())
+      {
+        /* Release the custom I/O context, flushing all the data to the memory buffer
+         * or to the file */
+        avio_flush(m_outputFormatContext->pb);
+        CloseCustomIo();
+        m_outputFormatContext->pb = NULL;
+        m_fileOpen = false;
+      }
+    else if (!(m_outputFormat->flags & AVFMT_NOFILE))
       {
         /* close the output file */
         avio_close(m_outputFormatContext->pb);
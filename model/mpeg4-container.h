@@ -22,6 +22,7 @@
 
 #include <cstdlib>
 #include <cassert>
+#include <sstream>
 #include "container.h"
 
 namespace ns3
@@ -35,6 +36,16 @@ namespace ns3
     virtual bool
     InitForWrite();
 
+    /* Method used to enable the fragmented mp4 output: the file starts with an empty
+     * moov box and the packets are written in moof/mdat fragments of (about)
+     * fragmentDuration seconds, so that it can be decoded while it is being written and
+     * the muxer does not keep the index of the whole file. A zero duration (default)
+     * produces a classic mp4 file. It has to be called before InitForWrite. */
+    void
+    SetFragmentDuration(double fragmentDuration);
+    double
+    GetFragmentDuration();
+
     /* Methods inherited from Container that have to be implemented. */
     virtual bool
     FinalizeFile();
@@ -43,6 +54,8 @@ namespace ns3
     PacketizeFromQueue();
 
     unsigned long int m_lastPts;
+
+    double m_fragmentDuration;
   };
 
 }
@@ -51,8 +51,17 @@ namespace ns3
     m_jitterBufferLength = jitterBufferLength;
     m_startedReception = false;
     m_currentJitterEstimate = 0;
+    m_eModel = NULL;
     m_fileType = m_simulationDataset->GetFileType();
 
+    /* Each receiver needs its own dataset (see SetupFileType) */
+    if (!m_simulationDataset->AttachReceiver())
+      {
+        std::cout << "MultimediaApplicationReceiver: The simulation dataset is already "
+                  << "used by another receiver\n";
+        assert(false);
+      }
+
     m_packetBuffer = (uint8_t*) calloc(_RECEIVER_PACKET_BUFFER_LENGTH, sizeof(uint8_t));
     assert(m_packetBuffer != NULL);
 
@@ -113,20 +122,74 @@ namespace ns3
             /* I push the current row to the stored trace */
             m_simulationDataset->PushBackReceiverTraceRow(receiverTraceRow);
 
+            /* In the virtual payload mode the packet carries a zero-filled payload, and
+             * the actual one is read in place from the payload store of the dataset. It
+             * is released as soon as the rebuilder has consumed it. */
+            const uint8_t* storedPayload = NULL;
+            unsigned int storedPayloadSize = 0;
+            if (m_simulationDataset->GetVirtualPayloads())
+              {
+                storedPayload = m_simulationDataset->GetPacketPayload(rtpHeader.GetPacketId(),
+                                                                      &storedPayloadSize);
+                if (storedPayload == NULL || storedPayloadSize != packet->GetSize())
+                  {
+                    std::cout << "MultimediaApplicationReceiver: no payload stored for packet "
+                              << rtpHeader.GetPacketId() << "\n";
+                    storedPayload = NULL;
+                  }
+              }
+
             /* Now I must check if the current packet belongs to an AUDIO or a VIDEO file */
             if (m_fileType == SimulationDataset::AUDIO)
               {
                 /* TODO - audio reception */
 
                 /* I pass the current packet to the rebuilder */
-                unsigned int packetSize = packet->CopyData(m_packetBuffer,
-                    _RECEIVER_PACKET_BUFFER_LENGTH);
-                m_fileRebuilder->SetNextPacket(rtpHeader, m_packetBuffer,
-                    packetSize);
+                if (storedPayload != NULL)
+                  {
+                    /* The rebuilder only reads the payload */
+                    m_fileRebuilder->SetNextPacket(rtpHeader, (uint8_t*) storedPayload,
+                        storedPayloadSize);
+                  }
+                else
+                  {
+                    unsigned int packetSize = packet->CopyData(m_packetBuffer,
+                        _RECEIVER_PACKET_BUFFER_LENGTH);
+                    m_fileRebuilder->SetNextPacket(rtpHeader, m_packetBuffer,
+                        packetSize);
+                  }
+                m_simulationDataset->ReleasePacketPayload(rtpHeader.GetPacketId());
+
+                /* Each audio packet is a complete frame */
+                m_fileRebuilder->TrackFrame(rtpHeader, m_lastReceivedTime, true);
               }
             else if (m_fileType == SimulationDataset::VIDEO)
               {
                 /* Video reception */
+                if (m_simulationDataset->GetNalAwarePacketization())
+                  {
+                    /* RFC 6184 packet: the rebuilder parses the payload headers on its own */
+                    if (storedPayload != NULL)
+                      {
+                        m_fileRebuilder->SetNextRtpPayload(rtpHeader, storedPayload,
+                                                           storedPayloadSize);
+                      }
+                    else
+                      {
+                        m_fileRebuilder->SetNextRtpPayload(rtpHeader, packet);
+                      }
+                    m_simulationDataset->ReleasePacketPayload(rtpHeader.GetPacketId());
+                    m_fileRebuilder->TrackFrame(rtpHeader, m_lastReceivedTime,
+                                                rtpHeader.GetMarker());
+                    continue;
+                  }
+
+                /* The headers are parsed from the packet itself */
+                if (storedPayload != NULL)
+                  {
+                    packet = Create<Packet>(storedPayload, storedPayloadSize);
+                  }
+                m_simulationDataset->ReleasePacketPayload(rtpHeader.GetPacketId());
 
                 /* Nal unit header extraction */
                 packet->RemoveHeader(nalHeader);
@@ -140,6 +203,7 @@ namespace ns3
                         _RECEIVER_PACKET_BUFFER_LENGTH);
                     m_fileRebuilder->SetNextPacket(rtpHeader, m_packetBuffer,
                         packetSize);
+                    m_fileRebuilder->TrackFrame(rtpHeader, m_lastReceivedTime, true);
 
 #if _MULTIMEDIA_APPLICATION_RECEIVER_DEBUG
                     std::cout << "NAL UNIT received at: " << Simulator::Now().GetSeconds () << " seconds\n";
@@ -160,15 +224,20 @@ namespace ns3
 
                     /* Now I pass the current fragment to the file rebuilder */
                     m_fileRebuilder->SetNextFragment(rtpHeader, fragHeader, packet);
+                    m_fileRebuilder->TrackFrame(rtpHeader, m_lastReceivedTime,
+                                                fragHeader.IsEnd());
                   }
               }
           }
-#if _MULTIMEDIA_APPLICATION_RECEIVER_JITTER_DEBUG
         else
           {
+            /* The discarded packet will never be consumed */
+            m_simulationDataset->ReleasePacketPayload(rtpHeader.GetPacketId());
+
+#if _MULTIMEDIA_APPLICATION_RECEIVER_JITTER_DEBUG
             std::cout << "Packet dropped at: " << Simulator::Now().GetSeconds () << " seconds because of jitter excess\n";
-          }
 #endif
+          }
       }
   }
 
@@ -184,6 +253,19 @@ namespace ns3
         m_socket->Close();
       }
 
+    /* No more packets will be consumed: the payloads of the lost ones are released */
+    if (m_simulationDataset->GetVirtualPayloads())
+      {
+        m_simulationDataset->ReleasePacketPayloadsBefore(
+            m_simulationDataset->GetPacketTraceSize());
+      }
+
+    /* The packets received after the last report would otherwise be ignored */
+    if (m_eModel != NULL)
+      {
+        m_eModel->Flush();
+      }
+
     /* Finalize the output file */
     m_fileRebuilder->FinalizeFile();
   }
@@ -193,6 +275,13 @@ namespace ns3
   bool
   MultimediaApplicationReceiver::CheckJitter(RtpProtocol rtpHeader)
   {
+    if (m_eModel != NULL)
+      {
+        /* The E-model needs the one-way network delay of every packet */
+        m_eModel->RecordDelay(Simulator::Now().GetSeconds() -
+            m_simulationDataset->GetSenderTimestamp(rtpHeader.GetPacketId()));
+      }
+
     if (!m_startedReception)
       {
         /* The packet must be accepted because it is the first one */
@@ -244,6 +333,11 @@ namespace ns3
       }
     else
       {
+        if (m_eModel != NULL)
+          {
+            m_eModel->RecordDiscard();
+          }
+
         return false;
       }
   }
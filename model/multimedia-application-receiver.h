@@ -44,6 +44,7 @@
 #include "ns3/packetizer.h"
 #include "ns3/packet-trace-structure.h"
 #include "ns3/multimedia-file-rebuilder.h"
+#include "ns3/e-model.h"
 #include "ns3/callback.h"
 
 namespace ns3
@@ -77,6 +78,9 @@ namespace ns3
 
     MultimediaFileRebuilder* m_fileRebuilder;
 
+    /* Optional E-model estimator, fed with network delays and jitter buffer discards */
+    EModel* m_eModel;
+
     /* Packet buffer used to store the payload of a received packet */
     uint8_t* m_packetBuffer;
 
@@ -117,6 +121,25 @@ namespace ns3
       m_fileRebuilder = fileRebuilder;
     }
 
+    /* Method used to override the file type of the dataset, e.g., when the audio and
+     * video streams of a MIX file are received by two different receivers. Each of
+     * them needs its own dataset (with the same original file): packet IDs, traces
+     * and payloads are per stream, and Init refuses a dataset already in use. */
+    void
+    SetupFileType(SimulationDataset::FileType fileType)
+    {
+      m_fileType = fileType;
+    }
+
+    void
+    SetupEModel(EModel* eModel)
+    {
+      m_eModel = eModel;
+
+      /* The jitter buffer contributes to the mouth-to-ear delay */
+      m_eModel->SetPlayoutDelay(m_jitterBufferLength.GetSeconds());
+    }
+
     virtual
     ~MultimediaApplicationReceiver()
     {
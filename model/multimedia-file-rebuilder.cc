@@ -38,6 +38,14 @@ namespace ns3
     assert(m_packetBuffer != NULL);
 
     m_isFirstStart = false;
+    m_startedReception = false;
+    m_frameTrackingStarted = false;
+    m_eModel = NULL;
+
+    m_accessUnitStarted = false;
+    m_fragmentedNalStarted = false;
+    m_fragmentedNalOffset = 0;
+    m_nalLengthSize = 0;
   }
 
   void
@@ -235,6 +243,16 @@ namespace ns3
             nextPacketId = CreateAndPushProxyPacket(nextPacketId);
           }
         while (nextPacketId < rtpHeader.GetPacketId());
+
+        if (m_eModel != NULL && currentPacketId > lastPacketId + 1)
+          {
+            m_eModel->RecordLoss(currentPacketId - lastPacketId - 1);
+          }
+      }
+
+    if (m_eModel != NULL)
+      {
+        m_eModel->RecordReception();
       }
 
     /* Now I can send the received packet to the output context */
@@ -242,14 +260,206 @@ namespace ns3
     m_lastRtpHeader = rtpHeader;
   }
 
+  void
+  MultimediaFileRebuilder::SetNextRtpPayload(RtpProtocol rtpHeader, Ptr<Packet> payload)
+  {
+    unsigned int payloadSize = payload->CopyData(m_packetBuffer, _PACKET_BUFFER_LENGTH);
+    SetNextRtpPayload(rtpHeader, m_packetBuffer, payloadSize);
+  }
+
+  void
+  MultimediaFileRebuilder::SetNextRtpPayload(RtpProtocol rtpHeader, const uint8_t* payload,
+                                             unsigned int payloadSize)
+  {
+    unsigned int expectedPacketId = m_startedReception ?
+        m_accessUnitLastHeader.GetPacketId() + 1 : 0;
+    m_startedReception = true;
+
+    if (m_eModel != NULL)
+      {
+        if (rtpHeader.GetPacketId() > expectedPacketId)
+          {
+            m_eModel->RecordLoss(rtpHeader.GetPacketId() - expectedPacketId);
+          }
+        m_eModel->RecordReception();
+      }
+
+    if (m_accessUnitStarted &&
+        m_accessUnitFirstHeader.GetPacketTimestamp() != rtpHeader.GetPacketTimestamp())
+      {
+        /* The packet carrying the marker bit of the previous access unit has been lost */
+        FlushAccessUnit();
+      }
+
+    if (!m_accessUnitStarted)
+      {
+        m_accessUnitFirstHeader = rtpHeader;
+        m_accessUnitStarted = true;
+      }
+    else if (rtpHeader.GetPacketId() != expectedPacketId && m_fragmentedNalStarted)
+      {
+        /* A fragment of the current NAL unit has been lost: I drop the NAL unit */
+        m_accessUnit.resize(m_fragmentedNalOffset);
+        m_fragmentedNalStarted = false;
+      }
+
+    m_accessUnitLastHeader = rtpHeader;
+
+    if (payloadSize > 0)
+      {
+        uint8_t nalType = payload[0] & 0x1F;
+
+        if (nalType == NalUnitHeader::STAP_A)
+          {
+            unsigned int offset = 1;
+            while (offset + 2 <= payloadSize)
+              {
+                unsigned int nalSize = (payload[offset] << 8) | payload[offset + 1];
+                offset += 2;
+
+                if (nalSize > payloadSize - offset)
+                  {
+                    std::cout << "MultimediaFileRebuilder: malformed STAP-A packet "
+                              << rtpHeader.GetPacketId() << "\n";
+                    break;
+                  }
+
+                AppendNalUnit(&payload[offset], nalSize);
+                offset += nalSize;
+              }
+          }
+        else if (nalType == NalUnitHeader::FU_A && payloadSize >= 2)
+          {
+            bool isStart = (payload[1] & 0x80) != 0;
+            bool isEnd = (payload[1] & 0x40) != 0;
+
+            if (isStart)
+              {
+                if (m_fragmentedNalStarted)
+                  {
+                    /* The END fragment of the previous NAL unit has been lost */
+                    m_accessUnit.resize(m_fragmentedNalOffset);
+                  }
+
+                /* I rebuild the original NAL unit header from the FU indicator and the
+                 * FU header, after a length field which is filled upon the END fragment */
+                m_fragmentedNalOffset = m_accessUnit.size();
+                m_fragmentedNalStarted = true;
+                m_accessUnit.resize(m_fragmentedNalOffset + GetNalLengthSize(), 0);
+                m_accessUnit.push_back((payload[0] & 0xE0) | (payload[1] & 0x1F));
+              }
+
+            /* A fragment whose START has been lost is useless */
+            if (m_fragmentedNalStarted)
+              {
+                m_accessUnit.insert(m_accessUnit.end(), &payload[2],
+                                    &payload[payloadSize]);
+
+                if (isEnd)
+                  {
+                    WriteNalLength(m_fragmentedNalOffset, m_accessUnit.size() -
+                                   m_fragmentedNalOffset - GetNalLengthSize());
+                    m_fragmentedNalStarted = false;
+                  }
+              }
+          }
+        else
+          {
+            /* Single NAL unit packet */
+            AppendNalUnit(payload, payloadSize);
+          }
+      }
+
+    if (rtpHeader.GetMarker())
+      {
+        FlushAccessUnit();
+      }
+  }
+
+  unsigned int
+  MultimediaFileRebuilder::GetNalLengthSize()
+  {
+    /* The output file keeps the avcC record of the source, so the NAL units must be
+     * prefixed with lengths of the size it declares */
+    if (m_nalLengthSize == 0)
+      {
+        m_nalLengthSize = m_outputContainer->GetNalLengthSize();
+      }
+
+    return m_nalLengthSize;
+  }
+
+  void
+  MultimediaFileRebuilder::WriteNalLength(unsigned int offset, unsigned int nalSize)
+  {
+    unsigned int lengthSize = GetNalLengthSize();
+    for (unsigned int i = 0; i < lengthSize; i++)
+      {
+        m_accessUnit[offset + i] = (nalSize >> (8 * (lengthSize - 1 - i))) & 0xFF;
+      }
+  }
+
+  void
+  MultimediaFileRebuilder::AppendNalUnit(const uint8_t* nal, unsigned int nalSize)
+  {
+    unsigned int offset = m_accessUnit.size();
+    m_accessUnit.resize(offset + GetNalLengthSize());
+    WriteNalLength(offset, nalSize);
+    m_accessUnit.insert(m_accessUnit.end(), nal, nal + nalSize);
+  }
+
+  void
+  MultimediaFileRebuilder::FlushAccessUnit()
+  {
+    if (m_fragmentedNalStarted)
+      {
+        /* The NAL unit has not been completed */
+        m_accessUnit.resize(m_fragmentedNalOffset);
+        m_fragmentedNalStarted = false;
+      }
+
+    m_accessUnitStarted = false;
+
+    if (m_accessUnit.size() == 0)
+      {
+        /* Nothing survived: the whole access unit is replaced by a proxy packet when
+         * the next one is flushed, as if it had been completely lost */
+        return;
+      }
+
+    /* Whole access units lost before the current one are replaced by proxy packets.
+     * The ones sharing the current timestamp are part of the current access unit. */
+    unsigned int firstPacketId = m_accessUnitFirstHeader.GetPacketId();
+    unsigned int nextPacketId = m_lastRtpHeader.GetPacketId() + 1;
+
+    while (nextPacketId < firstPacketId &&
+           m_simulationDataset->GetPacketTraceRow(nextPacketId).m_rtpTimestamp !=
+           m_accessUnitFirstHeader.GetPacketTimestamp())
+      {
+        nextPacketId = CreateAndPushProxyPacket(nextPacketId);
+      }
+
+    /* As for the fragments, the container is provided with the packet ID of the last
+     * packet of the access unit */
+    RtpProtocol fakeHeader;
+
+    fakeHeader.SetPacketId(m_accessUnitLastHeader.GetPacketId());
+    fakeHeader.SetTimestamp(m_accessUnitFirstHeader.GetPacketTimestamp());
+    fakeHeader.SetSynchronizationSource(m_accessUnitFirstHeader.GetSynchronizationSource());
+
+    m_outputContainer->SetNextPacket(fakeHeader, &m_accessUnit[0], m_accessUnit.size());
+    m_lastRtpHeader = fakeHeader;
+    m_accessUnit.clear();
+  }
+
   /* FIXME TODO: verifica bene tutto!!! */
   unsigned int
   MultimediaFileRebuilder::CreateAndPushProxyPacket(unsigned int packetId)
   {
     /* First, I must check in the packet trace if the packetId refers to a fragment or
      * refers to a complete packet. */
-    std::vector<PacketTraceRow> copyPacketTrace = m_simulationDataset->GetPacketTrace();
-    PacketTraceRow currentPacketRow = copyPacketTrace[packetId];
+    const std::vector<PacketTraceRow>& packetTrace = m_simulationDataset->GetPacketTrace();
+    const PacketTraceRow& currentPacketRow = packetTrace[packetId];
     unsigned int currentNumberOfFragments = currentPacketRow.m_numberOfFragments;
     unsigned int startingId = GetStartingFragmentId(packetId);
 
@@ -260,7 +470,7 @@ namespace ns3
     unsigned int i = startingId;
     do
       {
-        totalPacketLength += copyPacketTrace[i].m_packetSize;
+        totalPacketLength += packetTrace[i].m_packetSize;
         i++;
       }
     while (i < nextPacketId);
@@ -268,7 +478,7 @@ namespace ns3
 #if 0
     for (unsigned int i = startingId; i < nextPacketId; i++)
       {
-        totalPacketLength += copyPacketTrace[i].m_packetSize;
+        totalPacketLength += packetTrace[i].m_packetSize;
       }
 #endif
 
@@ -286,6 +496,13 @@ namespace ns3
 
     m_lastRtpHeader = lostHeader;
 
+    /* The replaced packets are declared lost: their stored payloads, if any, will never
+     * be used */
+    for (unsigned int lostId = startingId; lostId < nextPacketId; lostId++)
+      {
+        m_simulationDataset->ReleasePacketPayload(lostId);
+      }
+
     free(tempBuffer);
     return nextPacketId;
   }
@@ -295,8 +512,8 @@ namespace ns3
   {
     /* First, I must check in the packet trace if the packetId refers to a fragment or
      * refers to a complete packet. */
-    std::vector<PacketTraceRow> copyPacketTrace = m_simulationDataset->GetPacketTrace();
-    PacketTraceRow currentPacketRow = copyPacketTrace[fragmentId];
+    const std::vector<PacketTraceRow>& packetTrace = m_simulationDataset->GetPacketTrace();
+    const PacketTraceRow& currentPacketRow = packetTrace[fragmentId];
     unsigned int currentNumberOfFragments = currentPacketRow.m_numberOfFragments;
     unsigned int startingId = fragmentId;
 
@@ -305,7 +522,7 @@ namespace ns3
         /* Find the first fragment of the packet */
         int firstFragmentId = fragmentId - 1;
 
-        while (copyPacketTrace[firstFragmentId].m_rtpTimestamp ==
+        while (packetTrace[firstFragmentId].m_rtpTimestamp ==
                currentPacketRow.m_rtpTimestamp)
           {
             firstFragmentId--;
@@ -342,10 +559,9 @@ namespace ns3
 
         for (unsigned int i = lastFragmentId + 1; i < currentFragmentId; i++)
           {
-            unsigned int lostFragmentSize =
-                m_simulationDataset->GetPacketTrace()[i].m_packetSize;
-            unsigned long int lostRtpTimestamp =
-                m_simulationDataset->GetPacketTrace()[i].m_rtpTimestamp;
+            const PacketTraceRow& lostRow = m_simulationDataset->GetPacketTraceRow(i);
+            unsigned int lostFragmentSize = lostRow.m_packetSize;
+            unsigned long int lostRtpTimestamp = lostRow.m_rtpTimestamp;
 
             uint8_t* emptyBuffer = (uint8_t*) calloc(lostFragmentSize, sizeof(uint8_t));
             assert(emptyBuffer != NULL);
@@ -368,9 +584,56 @@ namespace ns3
       }
   }
 
+  void
+  MultimediaFileRebuilder::TrackFrame(RtpProtocol rtpHeader, double receptionTime,
+                                      bool isLastFragment)
+  {
+    unsigned int packetId = rtpHeader.GetPacketId();
+    double packetDelay = receptionTime - m_simulationDataset->GetSenderTimestamp(packetId);
+
+    if (!m_frameTrackingStarted ||
+        m_currentFrame.m_rtpTimestamp != rtpHeader.GetPacketTimestamp())
+      {
+        /* First received packet of a new frame. A previous frame whose last packet has
+         * never been received is simply discarded, since it never became complete. */
+        m_currentFrame.m_rtpTimestamp = rtpHeader.GetPacketTimestamp();
+        m_currentFrame.m_firstPacketId = packetId;
+        m_currentFrame.m_numberOfFragments =
+            m_simulationDataset->GetPacketTraceRow(packetId).m_numberOfFragments;
+        m_currentFrame.m_receivedFragments = 0;
+        m_currentFrame.m_firstByteDelay = packetDelay;
+        m_frameTrackingStarted = true;
+      }
+
+    m_currentFrame.m_receivedFragments++;
+
+    if (isLastFragment)
+      {
+        m_currentFrame.m_lastPacketId = packetId;
+        m_currentFrame.m_lastByteDelay = packetDelay;
+        m_currentFrame.m_completionTime = receptionTime;
+
+        m_simulationDataset->PushBackFrameTraceRow(m_currentFrame);
+        m_frameTrackingStarted = false;
+
+#if _MULTIMEDIA_FILE_REBUILDER_DEBUG
+        std::cout << "MultimediaFileRebuilder: frame " << m_currentFrame.m_rtpTimestamp
+                  << " completed at " << receptionTime << " ("
+                  << m_currentFrame.m_receivedFragments << "/"
+                  << m_currentFrame.m_numberOfFragments << " fragments)\n";
+#endif
+      }
+  }
+
   void
   MultimediaFileRebuilder::FinalizeFile()
   {
+    if (m_accessUnitStarted)
+      {
+        /* The last access unit has not been closed by its marker bit */
+        FlushAccessUnit();
+      }
+
     m_outputContainer->FinalizeFile();
     free(m_packetBuffer);
   }
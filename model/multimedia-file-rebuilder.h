@@ -22,6 +22,7 @@
 
 #include <iostream>
 #include <queue>
+#include <vector>
 #include <cstdlib>
 #include <cstdio>
 #include <cassert>
@@ -31,6 +32,8 @@
 #include "ns3/rtp-protocol.h"
 #include "ns3/container.h"
 #include "ns3/fragmentation-unit-header.h"
+#include "ns3/nal-unit-header.h"
+#include "ns3/e-model.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -77,6 +80,47 @@ namespace ns3
     /* Flag used to determine if the first fragment in the queue is actually a START fragment */
     bool m_isFirstStart;
 
+    /* Frame currently being received (i.e., the packets sharing the same RTP timestamp),
+     * used to trace the frame completion online */
+    FrameTraceRow m_currentFrame;
+    bool m_frameTrackingStarted;
+
+    /* Optional E-model estimator, fed with the received and lost packets */
+    EModel* m_eModel;
+
+    /* Access unit currently being rebuilt from RFC 6184 packets, in AVCC format (each
+     * NAL unit is preceded by its length, on as many bytes as the avcC record of the
+     * output container declares), together with the RTP headers of its first and last
+     * received packets */
+    std::vector<uint8_t> m_accessUnit;
+    bool m_accessUnitStarted;
+    RtpProtocol m_accessUnitFirstHeader;
+    RtpProtocol m_accessUnitLastHeader;
+
+    /* Offset within m_accessUnit of the NAL unit currently being rebuilt from FU-A
+     * fragments, if any */
+    bool m_fragmentedNalStarted;
+    unsigned int m_fragmentedNalOffset;
+
+    /* Size of the NAL unit length fields, 0 until it is read from the output container */
+    unsigned int m_nalLengthSize;
+
+    unsigned int
+    GetNalLengthSize();
+
+    /* Writes nalSize into the length field at offset within the access unit */
+    void
+    WriteNalLength(unsigned int offset, unsigned int nalSize);
+
+    /* Appends a NAL unit to the access unit being rebuilt */
+    void
+    AppendNalUnit(const uint8_t* nal, unsigned int nalSize);
+
+    /* Sends the access unit being rebuilt to the output container, after having
+     * replaced the whole access units lost before it with proxy packets */
+    void
+    FlushAccessUnit();
+
     /* Method used to create a proxy packet based on the index passed as parameter. If packetId
      * refers to a fragment, the method automatically reconstructs the whole packet the fragment refers
      * to.
@@ -104,6 +148,27 @@ namespace ns3
     void
     SetNextPacket(RtpProtocol rtpHeader, uint8_t* buffer, unsigned int packetSize);
 
+    /* Methods used to receive a packet of an RFC 6184 stream (single NAL unit, STAP-A
+     * or FU-A), payload included. The access unit is completed upon reception of the
+     * packet carrying the marker bit, or of a packet belonging to the next one. The
+     * second one reads the payload in place (e.g., from the payload store of the
+     * dataset, in the virtual payload mode), without building a packet. */
+    void
+    SetNextRtpPayload(RtpProtocol rtpHeader, Ptr<Packet> payload);
+    void
+    SetNextRtpPayload(RtpProtocol rtpHeader, const uint8_t* payload, unsigned int payloadSize);
+
+    void
+    SetupEModel(EModel* eModel)
+    {
+      m_eModel = eModel;
+    }
+
+    /* Method used to update the frame trace upon reception of a packet. If isLastFragment
+     * is true, the current frame is considered complete and its trace row is exported. */
+    void
+    TrackFrame(RtpProtocol rtpHeader, double receptionTime, bool isLastFragment);
+
     void
     FinalizeFile();
   };
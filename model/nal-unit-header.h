@@ -28,13 +28,14 @@ namespace ns3
   class NalUnitHeader : public Header
   {
   public:
-    /* Declaration of the possible kinds of NAL units.
-     * FIXME: currently only two types are supported, i.e., NAL-unit
-     * and FU-A. */
+    /* Declaration of the possible kinds of NAL units. Types from 1 to 23 are the
+     * ones carried as single NAL units; NAL_UNIT is used by the legacy packetization,
+     * which sends each whole access unit as a single "NAL unit". */
     enum NalUnitType
     {
       RESERVED = 0,
       NAL_UNIT = 23,
+      STAP_A = 24,
       FU_A = 28
     };
 
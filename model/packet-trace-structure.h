@@ -56,4 +56,44 @@ typedef struct
   double m_jitter;
 } JitterTraceRow;
 
+/* Declaration of the row structure regarding the frame trace. A frame is the set of
+ * packets sharing the same RTP timestamp; the row is filled at the receiver side as soon as
+ * the last packet of the frame arrives. */
+typedef struct
+{
+  unsigned long int m_rtpTimestamp;
+  unsigned int m_firstPacketId;
+  unsigned int m_lastPacketId;
+
+  /* Number of packets composing the frame at the sender side, and number of them
+   * actually received */
+  unsigned int m_numberOfFragments;
+  unsigned int m_receivedFragments;
+
+  /* Delays (in seconds) of the first and of the last received packet of the frame,
+   * together with the reception time of the last one (i.e., the completion time) */
+  double m_firstByteDelay;
+  double m_lastByteDelay;
+  double m_completionTime;
+} FrameTraceRow;
+
+/* Declaration of the row structure regarding the E-model trace: each row refers to the
+ * report interval ending at m_time */
+typedef struct
+{
+  double m_time;
+
+  /* Packet loss (in percent), burst ratio and number of packets discarded by the
+   * jitter buffer */
+  double m_packetLoss;
+  double m_burstRatio;
+  unsigned int m_discardedPackets;
+
+  /* Mouth-to-ear delay, in ms */
+  double m_oneWayDelay;
+
+  double m_rFactor;
+  double m_mos;
+} EModelTraceRow;
+
 #endif /* PACKET_TRACE_STRUCTURE_H_ */
@@ -17,6 +17,10 @@
  *          Daniela Saladino <daniela.saladino@unimore.it>
  */
 
+#include <cassert>
+
+#include "ns3/buffer.h"
+
 #include "packetizer.h"
 
 #define _PACKETIZER_DEBUG 0
@@ -27,77 +31,138 @@ namespace ns3
   Packetizer::Packetizer(int mtu, SimulationDataset* simulationDataset) :
                          m_mtu(mtu),
                          m_fragmentsQueue(),
-                         m_samplingInterval(0)
+                         m_samplingInterval(0),
+                         m_payloadBudget(0),
+                         m_synchronizationSource(0)
   {
     m_simulationDataset = simulationDataset;
   }
 
-  /* Implements a naive fragmentation method, which produces packets of MTU size if the
-   * current size exceeds the network's MTU */
   void
-  Packetizer::CreateFragments(AVPacket* frame)
+  Packetizer::SetPayloadBudget(unsigned int payloadBudget)
   {
-    unsigned int currentSize = frame->size;
-    unsigned int startingPointer = 0;
-    uint8_t tempBuffer[m_mtu];
-    unsigned int packetId = 0;
-    PacketTraceRow currentRow;
+    m_payloadBudget = payloadBudget;
+  }
 
-    currentRow.m_packetSize = m_mtu;
-    currentRow.m_playbackTimestamp = frame->pts * m_samplingInterval;
-    currentRow.m_decodingTimestamp = frame->dts * m_samplingInterval;
-    currentRow.m_rtpTimestamp = frame->dts; // FIXME: check if it is the dts or pts
+  unsigned int
+  Packetizer::GetPayloadBudget()
+  {
+    if (m_payloadBudget != 0)
+      {
+        return m_payloadBudget;
+      }
 
-    /* Calculate the number of fragments */
-    currentRow.m_numberOfFragments = ceil(((float) currentSize) / m_mtu);
+    assert(m_mtu > _IP_HEADER_LENGTH + _UDP_HEADER_LENGTH + _RTP_HEADER_LENGTH);
+    return m_mtu - _IP_HEADER_LENGTH - _UDP_HEADER_LENGTH - _RTP_HEADER_LENGTH;
+  }
 
-    /* Starting packet id extraction */
-    unsigned int currentPacketTraceSize =
-        (unsigned int) m_simulationDataset->GetPacketTrace().size();
+  Ptr<Packet>
+  Packetizer::CreatePayloadPacket(unsigned int packetId, const NalUnitHeader& nalHeader,
+                                  const FragmentationUnitHeader* fuHeader, const uint8_t* data,
+                                  unsigned int size)
+  {
+    if (!m_simulationDataset->GetVirtualPayloads())
+      {
+        Ptr<Packet> packet = Create<Packet> (data, size);
+        if (fuHeader != NULL)
+          {
+            packet->AddHeader(*fuHeader);
+          }
+        packet->AddHeader(nalHeader);
+
+        return packet;
+      }
 
-    if (currentPacketTraceSize == 0)
+    /* I serialize the payload headers exactly as AddHeader would do, and I place them
+     * in front of the data, directly into the payload store */
+    Buffer headers;
+    if (fuHeader != NULL)
       {
-        packetId = 0;
+        headers.AddAtStart(fuHeader->GetSerializedSize());
+        fuHeader->Serialize(headers.Begin());
       }
-    else
+    headers.AddAtStart(nalHeader.GetSerializedSize());
+    nalHeader.Serialize(headers.Begin());
+
+    unsigned int headersSize = headers.GetSize();
+    uint8_t* storedPayload =
+        m_simulationDataset->AllocatePacketPayload(packetId, headersSize + size);
+    headers.CopyData(storedPayload, headersSize);
+    if (size > 0)
       {
-        packetId = (m_simulationDataset->GetPacketTrace().back()).m_packetId + 1;
+        memcpy(storedPayload + headersSize, data, size);
       }
 
-    /* Actual fragmentation */
-    do
+    /* The zero-filled area of a packet is not backed by any buffer */
+    return Create<Packet> (headersSize + size);
+  }
+
+  /* Implements the FU-A fragmentation of a frame which does not fit into a single packet.
+   * The frame is split into the minimum number of fragments whose payload, together with
+   * the NAL unit and FU headers, fits into the payload budget; the fragments have equal
+   * sizes (give or take one byte), so that the last one is never a tiny leftover. Each
+   * fragment packet is created directly from its slice of the demuxed frame, so that the
+   * payload is copied exactly once. */
+  void
+  Packetizer::CreateFragments(AVPacket* frame)
+  {
+    unsigned int frameSize = frame->size;
+    PacketTraceRow currentRow;
+
+    /* Each fragment carries a NAL unit header and a FU header */
+    unsigned int payloadBudget = GetPayloadBudget();
+    assert(payloadBudget > 2 && frameSize >= 2);
+    unsigned int maxFragmentSize = payloadBudget - 2;
+
+    /* A frame that needs fragmentation is split into two fragments at least */
+    unsigned int numberOfFragments = (frameSize + maxFragmentSize - 1) / maxFragmentSize;
+    if (numberOfFragments < 2)
       {
-        memcpy(tempBuffer, &frame->data[startingPointer], m_mtu);
+        numberOfFragments = 2;
+      }
 
-        currentRow.m_packetId = packetId;
+    /* The first frameSize % numberOfFragments fragments take one more byte */
+    unsigned int fragmentSize = frameSize / numberOfFragments;
+    unsigned int longerFragments = frameSize % numberOfFragments;
 
-        /* Push back the trace row */
-        m_simulationDataset->PushBackPacketTraceRow(currentRow);
+    currentRow.m_playbackTimestamp = frame->pts * m_samplingInterval;
+    currentRow.m_decodingTimestamp = frame->dts * m_samplingInterval;
+    currentRow.m_rtpTimestamp = frame->dts; // FIXME: check if it is the dts or pts
+    currentRow.m_numberOfFragments = numberOfFragments;
+
+    /* Actual fragmentation */
+    unsigned int startingPointer = 0;
+    for (unsigned int i = 0; i < numberOfFragments; i++)
+      {
+        currentRow.m_packetSize = fragmentSize + ((i < longerFragments) ? 1 : 0);
 
-        /* Packet creation */
-        Ptr<Packet> packet = Create<Packet> (tempBuffer, m_mtu);
+        /* Push back the trace row, obtaining its packet ID */
+        currentRow.m_packetId = m_simulationDataset->AppendPacketTraceRow(currentRow);
 
-        /* Headers */
-        if (startingPointer == 0)
+        /* Headers: the first fragment has the START bit flag set, the last one the END
+         * bit flag, the middle ones neither of them */
+        FragmentationUnitHeader::FragmentationUnitType fragmentType =
+            FragmentationUnitHeader::UNSPECIFIED;
+        if (i == 0)
           {
-            /* First fragment - I must set the START bit flag */
-            FragmentationUnitHeader fragHeader(FragmentationUnitHeader::START, 0x00);
-            packet->AddHeader(fragHeader);
+            fragmentType = FragmentationUnitHeader::START;
           }
-        else
+        else if (i == numberOfFragments - 1)
           {
-            /* Middle fragment - Neither START nor END bit must be set */
-            FragmentationUnitHeader fragHeader(FragmentationUnitHeader::UNSPECIFIED, 0x00);
-            packet->AddHeader(fragHeader);
+            fragmentType = FragmentationUnitHeader::END;
           }
 
-        /* Add the NAL unit header */
+        FragmentationUnitHeader fragHeader(fragmentType, 0x00);
         NalUnitHeader nalHeader(0x00, NalUnitHeader::FU_A);
-        packet->AddHeader(nalHeader);
+
+        /* Packet creation, straight from the frame */
+        Ptr<Packet> packet = CreatePayloadPacket(currentRow.m_packetId, nalHeader, &fragHeader,
+                                                 &frame->data[startingPointer],
+                                                 currentRow.m_packetSize);
 
         /* Add the RTP header */
         RtpProtocol header(RtpProtocol::UNSPECIFIED, currentRow.m_packetId,
-                           currentRow.m_rtpTimestamp, 0);
+                           currentRow.m_rtpTimestamp, m_synchronizationSource);
         packet->AddHeader(header);
 
         /* Push back the fragment into the queue */
@@ -109,44 +174,7 @@ namespace ns3
                   << ", packet size: " << currentRow.m_packetSize << "\n";
 #endif
 
-        packetId++;
-        currentSize -= m_mtu;
-        startingPointer += m_mtu;
+        startingPointer += currentRow.m_packetSize;
       }
-    while (currentSize > m_mtu);
-
-    /* Last fragment */
-    memcpy(tempBuffer, &frame->data[startingPointer], currentSize);
-
-    currentRow.m_packetSize = currentSize;
-    currentRow.m_packetId = packetId;
-
-    /* Push back the trace row */
-    m_simulationDataset->PushBackPacketTraceRow(currentRow);
-
-    /* Packet creation */
-    Ptr<Packet> packet = Create<Packet> (tempBuffer, currentSize);
-
-    /* Headers */
-    FragmentationUnitHeader fragHeader(FragmentationUnitHeader::END, 0x00);
-    packet->AddHeader(fragHeader);
-
-    /* Add the NAL unit header */
-    NalUnitHeader nalHeader(0x00, NalUnitHeader::FU_A);
-    packet->AddHeader(nalHeader);
-
-    /* Add the RTP header */
-    RtpProtocol header(RtpProtocol::UNSPECIFIED, currentRow.m_packetId,
-                       currentRow.m_rtpTimestamp, 0);
-    packet->AddHeader(header);
-
-    /* Push back the fragment into the queue */
-    m_fragmentsQueue.push(packet);
-
-#if _PACKETIZER_DEBUG
-    std::cout << "Packetizer FRAGMENT data - packetId: " << currentRow.m_packetId
-              << ", timestamp: " << currentRow.m_rtpTimestamp
-              << ", packet size: " << currentRow.m_packetSize << "\n";
-#endif
   }
 } // namespace ns3
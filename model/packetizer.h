@@ -40,6 +40,11 @@ extern "C"
 #include "ns3/ptr.h"
 #include "ns3/packet.h"
 
+/* Lengths of the headers put in front of each RTP payload on its way to the network */
+#define _IP_HEADER_LENGTH 20
+#define _UDP_HEADER_LENGTH 8
+#define _RTP_HEADER_LENGTH 12
+
 namespace ns3
 {
 
@@ -54,9 +59,26 @@ namespace ns3
     /* A float value storing the samplingInterval */
     float m_samplingInterval;
 
+    /* Maximum size of an RTP payload, payload headers included (0 means that it is
+     * derived from the MTU) */
+    unsigned int m_payloadBudget;
+
+    /* RTP synchronization source identifier of the flow */
+    uint32_t m_synchronizationSource;
+
     void
     CreateFragments(AVPacket* frame);
 
+    /* Method used to create the RTP payload of packetId, made of the NAL unit header,
+     * the FU header (if not NULL) and size bytes of data. In the virtual payload mode of
+     * the dataset, the payload is written straight into the payload store of the dataset
+     * and a zero-filled packet of the same size is returned, so that data is copied
+     * exactly once. The RTP header has to be added by the caller. */
+    Ptr<Packet>
+    CreatePayloadPacket(unsigned int packetId, const NalUnitHeader& nalHeader,
+                        const FragmentationUnitHeader* fuHeader, const uint8_t* data,
+                        unsigned int size);
+
   public:
     Packetizer(int mtu, SimulationDataset* simulationDataset); // FIXME: change from pointer to smart-pointer
     virtual
@@ -71,6 +93,50 @@ namespace ns3
 
     virtual uint32_t
     GetPayloadLength() = 0;
+
+    unsigned int
+    GetMtu()
+    {
+      return m_mtu;
+    }
+
+    /* Method used to obtain the sampling interval of the packetized stream, i.e., the
+     * duration in seconds of a unit of its RTP timestamps */
+    float
+    GetSamplingInterval()
+    {
+      return m_samplingInterval;
+    }
+
+    /* Methods used to set the maximum size of the RTP payload of each packet, NAL unit
+     * and FU headers included. As default, it is the MTU minus the IP, UDP and RTP
+     * headers, so that a packet never needs IP fragmentation. */
+    void
+    SetPayloadBudget(unsigned int payloadBudget);
+    unsigned int
+    GetPayloadBudget();
+
+    /* Methods used to set the RTP synchronization source identifier carried by the
+     * packets, so that flows sharing the same content can be told apart (0 as default) */
+    void
+    SetSynchronizationSource(uint32_t synchronizationSource)
+    {
+      m_synchronizationSource = synchronizationSource;
+    }
+    uint32_t
+    GetSynchronizationSource()
+    {
+      return m_synchronizationSource;
+    }
+
+    /* Method used to let the underlying container demux the input file in
+     * background (see Container::EnableReadAhead). Returns false if the packetizer
+     * does not support it. */
+    virtual bool
+    EnableReadAhead(unsigned int /* queueLength */)
+    {
+      return false;
+    }
   };
 
 } // namespace ns3
@@ -19,6 +19,8 @@
 
 #include <iostream>
 #include <fstream>
+#include <cstring>
+#include <cassert>
 
 #include "pcm-mu-law-packetizer.h"
 #include "packetizer.h"
@@ -35,87 +37,196 @@ namespace ns3
     Packetizer(mtu, simulationDataset), m_wavContainer(
         simulationDataset->GetOriginalCodedFile(), WavContainer::READ, AVMEDIA_TYPE_AUDIO)
   {
+    m_sourceContainer = NULL;
+    m_currentFrameValid = false;
+    m_currentOffset = 0;
+    m_packetizationTime = _RTP_PCM_DEFAULT_PTIME;
+    m_payloadSize = 0;
+    m_bytesPerSample = 1;
+
+    if (simulationDataset->GetUseContainerIndex())
+      {
+        m_wavContainer.EnableIndex();
+      }
+    if (simulationDataset->GetSourceWindowEnabled())
+      {
+        m_wavContainer.SetWindow(simulationDataset->GetSourceWindowStart(),
+                                 simulationDataset->GetSourceWindowDuration());
+      }
     m_wavContainer.InitForRead();
     m_samplingInterval = m_wavContainer.GetSamplingInterval();
   }
 
+  PcmMuLawPacketizer::PcmMuLawPacketizer(int mtu,
+      SimulationDataset* simulationDataset, Container* sourceContainer) :
+    Packetizer(mtu, simulationDataset), m_wavContainer(
+        simulationDataset->GetOriginalCodedFile(), WavContainer::READ, AVMEDIA_TYPE_AUDIO)
+  {
+    /* The own container is left unopened */
+    m_sourceContainer = sourceContainer;
+    m_currentFrameValid = false;
+    m_currentOffset = 0;
+    m_packetizationTime = _RTP_PCM_DEFAULT_PTIME;
+    m_payloadSize = 0;
+    m_bytesPerSample = 1;
+    m_samplingInterval = m_sourceContainer->GetSamplingInterval();
+  }
+
   bool
-  PcmMuLawPacketizer::GetNextPacket(Ptr<Packet>& packet)
+  PcmMuLawPacketizer::EnableReadAhead(unsigned int queueLength)
   {
-    unsigned int packetId = 0;
-    unsigned long int timestamp = 0;
-    uint8_t buffer[_RTP_PCM_PAYLOAD_SIZE];
-    unsigned int packetSize;
+    return GetSourceContainer()->EnableReadAhead(queueLength);
+  }
+
+  PcmMuLawPacketizer::~PcmMuLawPacketizer()
+  {
+    if (m_currentFrameValid)
+      {
+        av_free_packet(&m_currentFrame);
+      }
+  }
+
+  bool
+  PcmMuLawPacketizer::SetPacketizationTime(unsigned int milliseconds)
+  {
+    if (milliseconds != 10 && milliseconds != 20 && milliseconds != 30 && milliseconds != 60)
+      {
+        std::cout << "PcmMuLawPacketizer: unsupported packetization time " << milliseconds
+                  << " ms (10, 20, 30 or 60 ms expected)\n";
+        return false;
+      }
 
-    if (GetNextPacket(&packetId, &timestamp, buffer, &packetSize))
+    /* Each packet must carry a whole packetization time, so the payload has to fit
+     * into the payload budget */
+    unsigned int payloadSize = ComputePayloadSize(milliseconds);
+    if (payloadSize > GetPayloadBudget())
       {
-        /* Initialize the packet */
-        packet = Create<Packet> (buffer, packetSize);
+        std::cout << "PcmMuLawPacketizer: packetization time " << milliseconds << " ms needs "
+                  << payloadSize << " bytes per packet, more than the payload budget ("
+                  << GetPayloadBudget() << " bytes)\n";
+        return false;
+      }
 
-        /* I create the RTP header
-         * FIXME: currently I fix the synch. source always to 0 */
-        RtpProtocol rtpHeader(RtpProtocol::UNSPECIFIED, packetId,
-                              timestamp, 0);
-        packet->AddHeader(rtpHeader);
+    m_packetizationTime = milliseconds;
+    m_payloadSize = 0;
+    return true;
+  }
+
+  unsigned int
+  PcmMuLawPacketizer::GetPacketizationTime()
+  {
+    return m_packetizationTime;
+  }
+
+  unsigned int
+  PcmMuLawPacketizer::ComputePayloadSize(unsigned int milliseconds)
+  {
+    /* Each sample takes a byte per channel, and the timestamps are expressed in samples */
+    int channels = GetSourceContainer()->GetCodecContext().channels;
+    m_bytesPerSample = (channels > 0) ? channels : 1;
 
-        return true;
+    /* The sampling interval is the duration of a sample (8 kHz as a fallback) */
+    double samplingInterval = (m_samplingInterval > 0) ? m_samplingInterval : 1.0 / 8000;
+    unsigned int samplesPerPacket =
+        (unsigned int) (milliseconds / (1000.0 * samplingInterval) + 0.5);
+
+    return samplesPerPacket * m_bytesPerSample;
+  }
+
+  void
+  PcmMuLawPacketizer::SetupPayloadSize()
+  {
+    m_payloadSize = ComputePayloadSize(m_packetizationTime);
+
+    /* The budget may have been lowered after the packetization time was chosen: I keep
+     * as many whole samples as fit into it, so that no packet exceeds the MTU */
+    unsigned int payloadBudget = GetPayloadBudget();
+    if (m_payloadSize > payloadBudget)
+      {
+        unsigned int clampedSize = (payloadBudget / m_bytesPerSample) * m_bytesPerSample;
+        std::cout << "PcmMuLawPacketizer: a " << m_packetizationTime << " ms payload ("
+                  << m_payloadSize << " bytes) exceeds the payload budget, " << clampedSize
+                  << " bytes per packet are used instead\n";
+        m_payloadSize = clampedSize;
       }
 
-    return false;
+    assert(m_payloadSize > 0);
+    m_joinBuffer.resize(m_payloadSize);
   }
 
-  /* This method returns the next packet from the packet queue into the buffer. Moreover, it
-   * fills the timestamp and the packetId, too.
-   * Returns true if everything went well, false otherwise. */
   bool
-  PcmMuLawPacketizer::GetNextPacket(unsigned int* packetId,
-      unsigned long int* timestamp, uint8_t* buffer, unsigned int* packetSize)
+  PcmMuLawPacketizer::GetNextPayload(const uint8_t** payload, unsigned long int* timestamp)
   {
-    /* Check the current size of the queue */
-    if (m_packetizationQueue.size() >= _RTP_PCM_PAYLOAD_SIZE)
+    if (m_payloadSize == 0)
       {
-        /* There are enough bytes stored in the queue to create an output packet */
-        FillOnePacket(packetId, timestamp, buffer, packetSize);
+        SetupPayloadSize();
       }
-    else
+
+    unsigned int joinedBytes = 0;
+
+    while (true)
       {
-        /* A new frame has to be read from the file */
-        AVPacket readFrame;
-        if (!m_wavContainer.GetNextPacket(&readFrame))
+        if (!m_currentFrameValid || m_currentOffset == (unsigned int) m_currentFrame.size)
           {
-            /* EOF has been reached */
-            return false;
+            /* The current frame is exhausted, a new one has to be read from the file */
+            if (m_currentFrameValid)
+              {
+                av_free_packet(&m_currentFrame);
+                m_currentFrameValid = false;
+              }
+
+            if (!GetSourceContainer()->GetNextPacket(&m_currentFrame))
+              {
+                /* EOF has been reached: a partial payload is discarded */
+                return false;
+              }
+
+            m_currentFrameValid = true;
+            m_currentOffset = 0;
+            continue;
           }
 
-        /* EOF has NOT been reached */
-        unsigned long int initialTimestamp = (unsigned long int) readFrame.pts;
+        unsigned int availableBytes = m_currentFrame.size - m_currentOffset;
 
-        /* I fill the queue with the entire packet */
-        for (int i = 0; i < readFrame.size; i++)
+        if (joinedBytes == 0)
           {
-            m_packetizationQueue.push(readFrame.data[i]);
-            m_timestampQueue.push(initialTimestamp + i);
+            /* The timestamp of the first sample of the payload */
+            *timestamp = (unsigned long int) m_currentFrame.pts + m_currentOffset / m_bytesPerSample;
+
+            if (availableBytes >= m_payloadSize)
+              {
+                /* The whole payload is a slice of the current frame */
+                *payload = &m_currentFrame.data[m_currentOffset];
+                m_currentOffset += m_payloadSize;
+                return true;
+              }
           }
 
-        /* Now I dequeue exactly ONE packet */
-        FillOnePacket(packetId, timestamp, buffer, packetSize);
+        /* The payload spans the end of the current frame: I join its pieces */
+        unsigned int copiedBytes = m_payloadSize - joinedBytes;
+        if (copiedBytes > availableBytes)
+          {
+            copiedBytes = availableBytes;
+          }
 
-        av_free_packet(&readFrame);
-      }
+        memcpy(&m_joinBuffer[joinedBytes], &m_currentFrame.data[m_currentOffset], copiedBytes);
+        joinedBytes += copiedBytes;
+        m_currentOffset += copiedBytes;
 
-    return true;
+        if (joinedBytes == m_payloadSize)
+          {
+            *payload = &m_joinBuffer[0];
+            return true;
+          }
+      }
   }
 
-  /* Method used to fill exactly one packet */
-  void
-  PcmMuLawPacketizer::FillOnePacket(unsigned int* packetId,
-      unsigned long int* timestamp, uint8_t* buffer, unsigned int* packetSize)
+  unsigned int
+  PcmMuLawPacketizer::PushBackTraceRow(unsigned long int timestamp)
   {
-    /* The current value of the timestamp is the one that has to be put in the RTP header */
     PacketTraceRow currentRow;
 
-    currentRow.m_packetSize = _RTP_PCM_PAYLOAD_SIZE;
-    *packetSize = _RTP_PCM_PAYLOAD_SIZE;
+    currentRow.m_packetSize = m_payloadSize;
 
     /* PCM packets do not require nor support fragmentation */
     currentRow.m_numberOfFragments = 1;
@@ -123,46 +234,75 @@ namespace ns3
     /* NB: The timestamp that has to be exported is a floating point value obtained from
      * the integer value extracted from the format! Moreover, the decoding timestamp is set
      * equal to the presentation timestamp. */
-    currentRow.m_rtpTimestamp = m_timestampQueue.front();
-    currentRow.m_playbackTimestamp = (m_timestampQueue.front())
-        * m_samplingInterval;
+    currentRow.m_rtpTimestamp = timestamp;
+    currentRow.m_playbackTimestamp = timestamp * m_samplingInterval;
     currentRow.m_decodingTimestamp = currentRow.m_playbackTimestamp;
 
-    /* I fill the output timestamp */
-    *timestamp = m_timestampQueue.front();
+    /* Push back the trace row, obtaining its packet ID */
+    currentRow.m_packetId = m_simulationDataset->AppendPacketTraceRow(currentRow);
+
+#if _PCM_MU_LAW_PACKETIZER_DEBUG
+    std::cout << "Pcm mu-law packetizer data - packetId: " << currentRow.m_packetId
+              << ", timestamp: " << timestamp << ", packet size: " << m_payloadSize << "\n";
+#endif
 
-    /* Check the size of the packet trace: if it is zero, this means that no packet
-     * has been traced yet. */
-    unsigned int currentPacketTraceSize =
-        (unsigned int) m_simulationDataset->GetPacketTrace().size();
+    return currentRow.m_packetId;
+  }
 
-    if (currentPacketTraceSize == 0)
+  bool
+  PcmMuLawPacketizer::GetNextPacket(Ptr<Packet>& packet)
+  {
+    const uint8_t* payload = NULL;
+    unsigned long int timestamp = 0;
+
+    if (!GetNextPayload(&payload, &timestamp))
+      {
+        return false;
+      }
+
+    unsigned int packetId = PushBackTraceRow(timestamp);
+
+    /* The packet is created straight from the payload slice */
+    if (m_simulationDataset->GetVirtualPayloads())
       {
-        currentRow.m_packetId = 0;
+        /* The payload goes to the store straight from the slice */
+        memcpy(m_simulationDataset->AllocatePacketPayload(packetId, m_payloadSize),
+               payload, m_payloadSize);
+        packet = Create<Packet> (m_payloadSize);
       }
     else
       {
-        currentRow.m_packetId
-            = (m_simulationDataset->GetPacketTrace().back()).m_packetId + 1;
+        packet = Create<Packet> (payload, m_payloadSize);
       }
 
-    /* I fill the output packetId */
-    *packetId = currentRow.m_packetId;
+    /* I create the RTP header */
+    RtpProtocol rtpHeader(RtpProtocol::UNSPECIFIED, packetId,
+                          timestamp, m_synchronizationSource);
+    packet->AddHeader(rtpHeader);
+
+    return true;
+  }
 
-    m_simulationDataset->PushBackPacketTraceRow(currentRow);
+  /* This method copies the next payload into the buffer, which must hold at least
+   * GetPayloadLength() bytes. Moreover, it fills the timestamp and the packetId, too.
+   * Returns true if everything went well, false otherwise. */
+  bool
+  PcmMuLawPacketizer::GetNextPacket(unsigned int* packetId,
+      unsigned long int* timestamp, uint8_t* buffer, unsigned int* packetSize)
+  {
+    const uint8_t* payload = NULL;
 
-    /* Now I extract exactly _RTP_PCM_PAYLOAD_SIZE bytes from the queue */
-    for (unsigned int i = 0; i < _RTP_PCM_PAYLOAD_SIZE; i++)
+    if (!GetNextPayload(&payload, timestamp))
       {
-        buffer[i] = m_packetizationQueue.front();
-        m_packetizationQueue.pop();
-        m_timestampQueue.pop();
+        return false;
       }
 
-#if _PCM_MU_LAW_PACKETIZER_DEBUG
-    std::cout << "Pcm mu-law packetizer data - packetId: " << *packetId << ", timestamp: " << *timestamp
-    << ", packet size: " << *packetSize << "\n";
-#endif
+    *packetId = PushBackTraceRow(*timestamp);
+
+    memcpy(buffer, payload, m_payloadSize);
+    *packetSize = m_payloadSize;
+
+    return true;
   }
 
 }
@@ -30,12 +30,14 @@ extern "C"
 #endif
 
 #include <queue>
+#include <vector>
 #include "wav-container.h"
 #include "packetizer.h"
 #include "packet-trace-structure.h"
 #include "rtp-protocol.h"
 
-#define _RTP_PCM_PAYLOAD_SIZE 160
+/* Default packetization time (ptime), in milliseconds */
+#define _RTP_PCM_DEFAULT_PTIME 20
 
 namespace ns3
 {
@@ -46,26 +48,77 @@ namespace ns3
     /* The wav file container used to read the input file */
     WavContainer m_wavContainer;
 
-    /* FIXME: Are the following variables useful or not?? */
+    /* External container the packets are read from, if any */
+    Container* m_sourceContainer;
 
-    /* A byte queue exploitable by the packetization process */
-    std::queue<uint8_t> m_packetizationQueue;
+    Container*
+    GetSourceContainer()
+    {
+      return (m_sourceContainer != NULL) ? m_sourceContainer : &m_wavContainer;
+    }
+
+    /* Demuxed frame the payloads are currently sliced from, and offset of its first
+     * byte not packetized yet */
+    AVPacket m_currentFrame;
+    bool m_currentFrameValid;
+    unsigned int m_currentOffset;
+
+    /* Buffer used to join the bytes of a payload spanning two (or more) frames */
+    std::vector<uint8_t> m_joinBuffer;
 
-    /* A timestamp queue associated with the previous one, to extract the proper timestamp
-     * when the actual packetization happens. */
-    std::queue<unsigned long int> m_timestampQueue;
+    /* Packetization time in milliseconds, and the resulting payload size. The latter is
+     * computed from the stream parameters when the first packet is requested. */
+    unsigned int m_packetizationTime;
+    unsigned int m_payloadSize;
+    unsigned int m_bytesPerSample;
 
+    /* Method used to compute the payload size of a packet carrying milliseconds of
+     * audio, from the stream parameters */
+    unsigned int
+    ComputePayloadSize(unsigned int milliseconds);
+
+    /* Method used to set m_payloadSize up, clamping it to the payload budget */
     void
-    FillOnePacket(unsigned int* packetId, unsigned long int* timestamp,
-        uint8_t* buffer, unsigned int* packetSize);
+    SetupPayloadSize();
+
+    /* Method used to obtain the next payload of m_payloadSize bytes and the timestamp of
+     * its first sample. The payload is a slice of the current frame, unless it spans
+     * more frames, in which case it is joined into m_joinBuffer.
+     * Returns false when the file does not contain a whole payload anymore. */
+    bool
+    GetNextPayload(const uint8_t** payload, unsigned long int* timestamp);
+
+    /* Method used to push back the trace row of a payload, obtaining its packet ID */
+    unsigned int
+    PushBackTraceRow(unsigned long int timestamp);
 
   public:
     PcmMuLawPacketizer(int mtu, SimulationDataset* simulationDataset);
 
+    /* Constructor used to read the packets from an already initialized container,
+     * e.g., a stream of a MixContainer shared with another packetizer */
+    PcmMuLawPacketizer(int mtu, SimulationDataset* simulationDataset, Container* sourceContainer);
+
+    virtual
+    ~PcmMuLawPacketizer();
+
+    /* Method used to set the packetization time (ptime), i.e., the audio duration carried
+     * by each packet: 10, 20 (default), 30 or 60 ms. It has to be called before the
+     * first packet is requested, and it fails if the resulting payload does not fit
+     * into the payload budget. */
+    bool
+    SetPacketizationTime(unsigned int milliseconds);
+    unsigned int
+    GetPacketizationTime();
+
     virtual uint32_t
     GetPayloadLength()
     {
-      return _RTP_PCM_PAYLOAD_SIZE;
+      if (m_payloadSize == 0)
+        {
+          SetupPayloadSize();
+        }
+      return m_payloadSize;
     }
 
     virtual bool
@@ -74,6 +127,9 @@ namespace ns3
 
     virtual bool
     GetNextPacket(Ptr<Packet>& packet);
+
+    virtual bool
+    EnableReadAhead(unsigned int queueLength);
   };
 
 }
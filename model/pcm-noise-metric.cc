@@ -17,16 +17,36 @@
  *          Daniela Saladino <daniela.saladino@unimore.it>
  */
 
+#include <algorithm>
 #include "pcm-noise-metric.h"
 
 namespace ns3
 {
 
+  PcmNoiseMetric::PcmNoiseMetric()
+  {
+    m_windowLength = 0;
+    m_windowSize = 0;
+    m_currentWindow.m_samples = 0;
+  }
+
+  void
+  PcmNoiseMetric::SetWindowLength(unsigned int windowLength)
+  {
+    m_windowLength = windowLength;
+  }
+
+  unsigned int
+  PcmNoiseMetric::GetWindowLength()
+  {
+    return m_windowLength;
+  }
+
   bool
   PcmNoiseMetric::EvaluateQoe(std::string originalFilename,
       std::string receivedFilename)
   {
-    /* The idea is to fill both queues with data coming from the two files. When enough
+    /* The idea is to fill both buffers with data coming from the two files. When enough
      * data is present, the comparison will start.
      * However, it is important to underline that the received file could be smaller
      * than the original one, because the simulation may last only a fraction of the whole
@@ -41,20 +61,28 @@ namespace ns3
     originalFile.InitForRead();
     receivedFile.InitForRead();
 
+    /* Number of samples (i.e., bytes) per window */
+    m_windowSize = (originalFile.GetSampleRate() * m_windowLength) / 1000;
+    if (m_windowLength > 0 && m_windowSize == 0)
+      {
+        std::cout << "PcmNoiseMetric: Error: invalid window length!\n";
+        return false;
+      }
+
     bool goOn = true;
     do
       {
-        /* Then I must fill the received file's queue */
-        if (!FillQueue(&receivedFile, RECEIVED))
+        /* Then I must fill the received file's buffer */
+        if (!FillBuffer(&receivedFile, RECEIVED))
           {
             /* EOC has been reached */
             goOn = false;
           }
 
-        if (!FillQueue(&originalFile, ORIGINAL))
+        if (!FillBuffer(&originalFile, ORIGINAL))
           {
             /* A more detailed check has to be done */
-            if (m_originalFileQueue.size() < m_receivedFileQueue.size())
+            if (m_originalFileBuffer.GetSize() < m_receivedFileBuffer.GetSize())
               {
                 std::cout
                     << "PcmNoiseMetric: Error: original file is smaller than the received one!\n";
@@ -63,69 +91,154 @@ namespace ns3
           }
 
         /* Now I have to compare the data stored in the buffers */
-        for (unsigned int i = 0; i < m_receivedFileQueue.size(); i++)
+        CompareBuffers();
+      }
+    while (goOn);
+
+    /* The last window may be partial */
+    if (m_windowSize > 0 && m_currentWindow.m_samples > 0)
+      {
+        CloseWindow();
+      }
+
+    return true;
+  }
+
+  void
+  PcmNoiseMetric::CompareBuffers()
+  {
+    while (m_receivedFileBuffer.GetSize() > 0 && m_originalFileBuffer.GetSize() > 0)
+      {
+        /* The block is the longest span which is contiguous in both buffers and
+         * belongs to a single timestamp run */
+        unsigned int originalLength = 0;
+        unsigned int receivedLength = 0;
+        const uint8_t* originalSamples = m_originalFileBuffer.Peek(&originalLength);
+        const uint8_t* receivedSamples = m_receivedFileBuffer.Peek(&receivedLength);
+
+        TimestampRun& currentRun = m_originalTimestamp.front();
+        unsigned int blockLength = std::min(std::min(originalLength, receivedLength),
+                                            currentRun.m_length);
+
+        if (m_windowSize > 0)
           {
-            char originalSample = m_originalFileQueue.front();
-            char receivedSample = m_receivedFileQueue.front();
-            unsigned long int currentTimestamp = m_originalTimestamp.front();
+            AccumulateWindow(originalSamples, receivedSamples, blockLength,
+                             currentRun.m_timestamp);
+          }
+        else
+          {
+            MetricRow currentRow;
+            for (unsigned int i = 0; i < blockLength; i++)
+              {
+                /* FIXME: Currently the metric is related only to a simple difference between the samples */
+                currentRow.m_noiseValue = ((double) (char) originalSamples[i])
+                    - (char) receivedSamples[i];
+                currentRow.m_timestamp = currentRun.m_timestamp + i;
+
+                m_metric.push_back(currentRow);
+              }
+          }
+
+        m_originalFileBuffer.Consume(blockLength);
+        m_receivedFileBuffer.Consume(blockLength);
 
-            m_originalFileQueue.pop();
-            m_receivedFileQueue.pop();
+        currentRun.m_timestamp += blockLength;
+        currentRun.m_length -= blockLength;
+        if (currentRun.m_length == 0)
+          {
             m_originalTimestamp.pop();
+          }
+      }
+  }
 
-            MetricRow currentRow;
+  void
+  PcmNoiseMetric::AccumulateWindow(const uint8_t* originalSamples,
+                                   const uint8_t* receivedSamples,
+                                   unsigned int length, unsigned long int timestamp)
+  {
+    unsigned int offset = 0;
+    while (offset < length)
+      {
+        if (m_currentWindow.m_samples == 0)
+          {
+            /* A new window starts here */
+            m_currentWindow.m_timestamp = timestamp + offset;
+            m_currentWindow.m_noiseSum = 0;
+            m_currentWindow.m_noiseEnergy = 0;
+            m_currentWindow.m_maxNoise = 0;
+            m_currentWindow.m_errors = 0;
+          }
 
-            /* FIXME: Currently the metric is related only to a simple difference between the samples */
-            currentRow.m_noiseValue = ((double) originalSample)
-                - receivedSample;
-            currentRow.m_timestamp = currentTimestamp;
+        /* Samples belonging to the current window */
+        unsigned int chunk = std::min(length - offset,
+                                      m_windowSize - m_currentWindow.m_samples);
 
-            m_metric.push_back(currentRow);
+        /* The same noise definition of the per-sample mode is used */
+        int noiseSum = 0;
+        long long noiseEnergy = 0;
+        int maxNoise = (int) m_currentWindow.m_maxNoise;
+        unsigned int errors = 0;
+        for (unsigned int i = offset; i < offset + chunk; i++)
+          {
+            int noise = ((int) (char) originalSamples[i]) - (char) receivedSamples[i];
+            int absNoise = noise < 0 ? -noise : noise;
+
+            noiseSum += noise;
+            noiseEnergy += noise * noise;
+            maxNoise = absNoise > maxNoise ? absNoise : maxNoise;
+            errors += (noise != 0);
+          }
+
+        m_currentWindow.m_noiseSum += noiseSum;
+        m_currentWindow.m_noiseEnergy += noiseEnergy;
+        m_currentWindow.m_maxNoise = maxNoise;
+        m_currentWindow.m_errors += errors;
+        m_currentWindow.m_samples += chunk;
+
+        if (m_currentWindow.m_samples == m_windowSize)
+          {
+            CloseWindow();
           }
 
+        offset += chunk;
       }
-    while (goOn);
+  }
 
-    return true;
+  void
+  PcmNoiseMetric::CloseWindow()
+  {
+    m_windowMetric.push_back(m_currentWindow);
+    m_currentWindow.m_samples = 0;
   }
 
   bool
-  PcmNoiseMetric::FillQueue(WavContainer* container, ByteQueue byteQueue)
+  PcmNoiseMetric::FillBuffer(WavContainer* container, ByteQueue byteQueue)
   {
-    std::queue<uint8_t>* currentQueue;
+    ByteRingBuffer* currentBuffer = &m_originalFileBuffer;
 
-    if (byteQueue == ORIGINAL)
+    if (byteQueue == RECEIVED)
       {
-        currentQueue = &m_originalFileQueue;
-      }
-    else if (byteQueue == RECEIVED)
-      {
-        currentQueue = &m_receivedFileQueue;
+        currentBuffer = &m_receivedFileBuffer;
       }
 
     AVPacket packet;
-    unsigned long int timestamp = 0;
-    while (currentQueue->size() < _QUEUE_TRESHOLD)
+    while (currentBuffer->GetSize() < _QUEUE_TRESHOLD)
       {
         if (container->GetNextPacket(&packet))
           {
-            /* Fill the proper queue */
+            /* Fill the proper buffer with the whole packet */
+            currentBuffer->Write(packet.data, packet.size);
+
             if (byteQueue == ORIGINAL)
               {
-                /* I extract also the presentation timestamp */
-                timestamp = packet.pts;
+                /* I store also the presentation timestamp of the packet */
+                TimestampRun run;
+                run.m_timestamp = packet.pts;
+                run.m_length = packet.size;
+                m_originalTimestamp.push(run);
               }
 
-            for (int i = 0; i < packet.size; i++)
-              {
-                if (byteQueue == ORIGINAL)
-                  {
-                    m_originalTimestamp.push(timestamp);
-                    timestamp++;
-                  }
-
-                currentQueue->push(packet.data[i]);
-              }
+            av_free_packet(&packet);
           }
         else
           {
@@ -146,6 +259,27 @@ namespace ns3
     std::fstream outputFile;
     outputFile.open(output.str().c_str(), std::ios::out);
 
+    if (m_windowSize > 0)
+      {
+        /* Windowed mode: one row per window */
+        if (headers)
+          {
+            outputFile << "timestamp, samples, noise-sum, noise-energy, max-noise, errors\n";
+          }
+
+        std::vector<WindowRow>::iterator windowIterator;
+        for (windowIterator = m_windowMetric.begin(); windowIterator < m_windowMetric.end();
+             windowIterator++)
+          {
+            outputFile << windowIterator->m_timestamp << ", " << windowIterator->m_samples << ", "
+                << windowIterator->m_noiseSum << ", " << windowIterator->m_noiseEnergy << ", "
+                << windowIterator->m_maxNoise << ", " << windowIterator->m_errors << "\n";
+          }
+
+        outputFile.close();
+        return true;
+      }
+
     /* Output trace print */
     if (headers)
       {
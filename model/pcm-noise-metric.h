@@ -27,6 +27,7 @@
 #include <iostream>
 #include <sstream>
 #include "ns3/wav-container.h"
+#include "ns3/byte-ring-buffer.h"
 #include "ns3/metric.h"
 
 #ifdef __cplusplus
@@ -47,6 +48,7 @@ namespace ns3
   class PcmNoiseMetric : public ns3::Metric
   {
   public:
+    PcmNoiseMetric();
 
     /* FIXME: I can't know the packet Id from the original and the received files only
      * (no packetization information is present!) */
@@ -56,6 +58,18 @@ namespace ns3
       double m_noiseValue;
     } MetricRow;
 
+    /* Aggregate statistics of the noise over a window of samples, used in
+     * windowed mode instead of one MetricRow per sample */
+    typedef struct WindowRow
+    {
+      unsigned long int m_timestamp;
+      unsigned int m_samples;
+      double m_noiseSum;
+      double m_noiseEnergy;
+      double m_maxNoise;
+      unsigned int m_errors;
+    } WindowRow;
+
     typedef enum ByteQueue
     {
       ORIGINAL, RECEIVED
@@ -66,15 +80,48 @@ namespace ns3
     virtual bool
     PrintResults(std::string outputFilename, bool headers);
 
+    /* Window length, in ms. If it is 0 (default), one row per sample is stored. */
+    void
+    SetWindowLength(unsigned int windowLength);
+    unsigned int
+    GetWindowLength();
+
   private:
-    std::queue<uint8_t> m_originalFileQueue;
-    std::queue<uint8_t> m_receivedFileQueue;
-    std::queue<unsigned long int> m_originalTimestamp;
+    /* A run of contiguous bytes of the original file, starting at m_timestamp: the
+     * timestamp of each byte is derived from the one of its run */
+    typedef struct TimestampRun
+    {
+      unsigned long int m_timestamp;
+      unsigned int m_length;
+    } TimestampRun;
+
+    ByteRingBuffer m_originalFileBuffer;
+    ByteRingBuffer m_receivedFileBuffer;
+    std::queue<TimestampRun> m_originalTimestamp;
 
     std::vector<MetricRow> m_metric;
 
+    /* Windowed mode: window length in ms and in samples, window being filled and
+     * completed windows */
+    unsigned int m_windowLength;
+    unsigned int m_windowSize;
+    WindowRow m_currentWindow;
+    std::vector<WindowRow> m_windowMetric;
+
     bool
-    FillQueue(WavContainer* container, ByteQueue byteQueue);
+    FillBuffer(WavContainer* container, ByteQueue byteQueue);
+
+    /* Method used to compare all the bytes available in both buffers */
+    void
+    CompareBuffers();
+
+    /* Methods used to accumulate a block of samples into the current window, and to
+     * store the current window once it is over */
+    void
+    AccumulateWindow(const uint8_t* originalSamples, const uint8_t* receivedSamples,
+                     unsigned int length, unsigned long int timestamp);
+    void
+    CloseWindow();
   };
 
 }
@@ -0,0 +1,285 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Alessandro Paganelli <alessandro.paganelli@unimore.it>
+ *          Daniela Saladino <daniela.saladino@unimore.it>
+ */
+
+
+#include <cmath>
+#include <algorithm>
+#include "pcm-segmental-snr-metric.h"
+
+#define _PCM_SEGMENTAL_SNR_METRIC_DEBUG 0
+
+namespace ns3
+{
+
+  PcmSegmentalSnrMetric::PcmSegmentalSnrMetric()
+  {
+    m_segmentLength = _SEGMENTAL_SNR_DEFAULT_SEGMENT;
+    m_segmentNumTot = 0;
+    m_avgSnr = 0;
+    m_originalTimestamp = 0;
+    m_readOffset = 0;
+
+    BuildLinearTable();
+  }
+
+  PcmSegmentalSnrMetric::PcmSegmentalSnrMetric(unsigned int segmentLength)
+  {
+    m_segmentLength = segmentLength;
+    m_segmentNumTot = 0;
+    m_avgSnr = 0;
+    m_originalTimestamp = 0;
+    m_readOffset = 0;
+
+    BuildLinearTable();
+  }
+
+  void
+  PcmSegmentalSnrMetric::SetSegmentLength(unsigned int segmentLength)
+  {
+    m_segmentLength = segmentLength;
+  }
+
+  unsigned int
+  PcmSegmentalSnrMetric::GetSegmentLength()
+  {
+    return m_segmentLength;
+  }
+
+  double
+  PcmSegmentalSnrMetric::GetAverageSegmentalSnr()
+  {
+    return m_avgSnr;
+  }
+
+  /* G.711 mu-law expansion, computed once for every possible byte value */
+  void
+  PcmSegmentalSnrMetric::BuildLinearTable()
+  {
+    for (unsigned int i = 0; i < 256; i++)
+      {
+        uint8_t muLawByte = ~((uint8_t) i);
+        int exponent = (muLawByte >> 4) & 0x07;
+        int mantissa = muLawByte & 0x0F;
+        int sample = (((mantissa << 3) + 0x84) << exponent) - 0x84;
+
+        m_linearTable[i] = (int16_t) ((muLawByte & 0x80) ? -sample : sample);
+      }
+  }
+
+  bool
+  PcmSegmentalSnrMetric::EvaluateQoe(std::string originalFilename,
+      std::string receivedFilename)
+  {
+    /* As for PcmNoiseMetric, the received file could be shorter than the original one,
+     * so the comparison stops as soon as the received file has been completely read. */
+    WavContainer originalFile(originalFilename, WavContainer::READ, AVMEDIA_TYPE_AUDIO);
+    WavContainer receivedFile(receivedFilename, WavContainer::READ, AVMEDIA_TYPE_AUDIO);
+
+    if (!originalFile.InitForRead() || !receivedFile.InitForRead())
+      {
+        std::cout << "PcmSegmentalSnrMetric: Error: cannot open input files!\n";
+        return false;
+      }
+
+    /* Number of samples (i.e., bytes) per segment */
+    unsigned int segmentSize = (originalFile.GetSampleRate() * m_segmentLength) / 1000;
+    if (segmentSize == 0)
+      {
+        std::cout << "PcmSegmentalSnrMetric: Error: invalid segment length!\n";
+        return false;
+      }
+
+    m_originalSegment.resize(segmentSize);
+    m_receivedSegment.resize(segmentSize);
+
+    bool goOn = true;
+    do
+      {
+        if (!FillBuffer(&receivedFile, &m_receivedBuffer, segmentSize, false))
+          {
+            /* EOF has been reached */
+            goOn = false;
+          }
+
+        /* The received packets may be larger than the original ones: the original
+         * buffer is topped up to (at least) the bytes available in the received one */
+        unsigned int receivedLength = m_receivedBuffer.size() - m_readOffset;
+        if (!FillBuffer(&originalFile, &m_originalBuffer, std::max(segmentSize, receivedLength),
+                        true) &&
+            m_originalBuffer.size() < m_receivedBuffer.size())
+          {
+            std::cout
+                << "PcmSegmentalSnrMetric: Error: original file is smaller than the received one!\n";
+            return false;
+          }
+
+        /* Now I compare every complete segment. The last (partial) one is evaluated
+         * only once the received file is over. */
+        unsigned int available = std::min(m_originalBuffer.size(), m_receivedBuffer.size());
+        unsigned int offset = m_readOffset;
+        while (offset < available &&
+               (offset + segmentSize <= available || !goOn))
+          {
+            unsigned int currentLength = std::min(segmentSize, available - offset);
+
+            MetricRow currentRow;
+            currentRow.m_timestamp = m_originalTimestamp + (offset - m_readOffset);
+            currentRow.m_snr = ComputeSegmentSnr(&m_originalBuffer[offset],
+                                                 &m_receivedBuffer[offset],
+                                                 currentLength);
+            m_metric.push_back(currentRow);
+
+            m_segmentNumTot++;
+            m_avgSnr += currentRow.m_snr;
+            offset += currentLength;
+          }
+
+        m_originalTimestamp += offset - m_readOffset;
+        m_readOffset = offset;
+
+        /* The bytes already compared are discarded only when they are the majority,
+         * so that each byte is moved at most once on average */
+        if (m_readOffset > m_receivedBuffer.size() / 2)
+          {
+            m_originalBuffer.erase(m_originalBuffer.begin(), m_originalBuffer.begin() + m_readOffset);
+            m_receivedBuffer.erase(m_receivedBuffer.begin(), m_receivedBuffer.begin() + m_readOffset);
+            m_readOffset = 0;
+          }
+      }
+    while (goOn);
+
+    if (m_segmentNumTot > 0)
+      {
+        m_avgSnr /= m_segmentNumTot;
+      }
+
+    return true;
+  }
+
+  /* Method used to append whole packets to the buffer until it contains at least
+   * length bytes after m_readOffset. Returns false if EOF has been reached. */
+  bool
+  PcmSegmentalSnrMetric::FillBuffer(WavContainer* container, std::vector<uint8_t>* buffer,
+                                    unsigned int length, bool original)
+  {
+    AVPacket packet;
+    while (buffer->size() - m_readOffset < length)
+      {
+        if (!container->GetNextPacket(&packet))
+          {
+            /* EOF has been reached */
+            return false;
+          }
+
+        if (original && buffer->size() == m_readOffset)
+          {
+            /* I extract also the presentation timestamp of the first byte */
+            m_originalTimestamp = packet.pts;
+          }
+
+        buffer->insert(buffer->end(), packet.data, packet.data + packet.size);
+        av_free_packet(&packet);
+      }
+
+    return true;
+  }
+
+  double
+  PcmSegmentalSnrMetric::ComputeSegmentSnr(const uint8_t* original, const uint8_t* received,
+                                           unsigned int length)
+  {
+    float* originalSegment = &m_originalSegment[0];
+    float* receivedSegment = &m_receivedSegment[0];
+
+    /* Table-driven linearization */
+    for (unsigned int i = 0; i < length; i++)
+      {
+        originalSegment[i] = m_linearTable[original[i]];
+        receivedSegment[i] = m_linearTable[received[i]];
+      }
+
+    /* Energy accumulation over four independent partial sums, so that the compiler
+     * can map the loop onto SIMD registers without reordering a single reduction */
+    float signal[4] = { 0, 0, 0, 0 };
+    float noise[4] = { 0, 0, 0, 0 };
+    unsigned int i = 0;
+    for (; i + 4 <= length; i += 4)
+      {
+        for (unsigned int j = 0; j < 4; j++)
+          {
+            float difference = originalSegment[i + j] - receivedSegment[i + j];
+            signal[j] += originalSegment[i + j] * originalSegment[i + j];
+            noise[j] += difference * difference;
+          }
+      }
+    for (; i < length; i++)
+      {
+        float difference = originalSegment[i] - receivedSegment[i];
+        signal[0] += originalSegment[i] * originalSegment[i];
+        noise[0] += difference * difference;
+      }
+
+    double signalEnergy = (double) signal[0] + signal[1] + signal[2] + signal[3];
+    double noiseEnergy = (double) noise[0] + noise[1] + noise[2] + noise[3];
+
+    /* Clipping, to prevent the division by 0 as well */
+    if (noiseEnergy == 0.0)
+      {
+        return _SEGMENTAL_SNR_MAX;
+      }
+    if (signalEnergy == 0.0)
+      {
+        return _SEGMENTAL_SNR_MIN;
+      }
+
+    double snr = 10 * log10(signalEnergy / noiseEnergy);
+
+#if _PCM_SEGMENTAL_SNR_METRIC_DEBUG
+    std::cout << "PcmSegmentalSnrMetric: segment snr " << snr << "\n";
+#endif
+
+    return std::max(_SEGMENTAL_SNR_MIN, std::min(_SEGMENTAL_SNR_MAX, snr));
+  }
+
+  bool
+  PcmSegmentalSnrMetric::PrintResults(std::string outputFilename, bool headers)
+  {
+    std::stringstream output;
+    output << outputFilename << "-segmental-snr-metric.csv";
+
+    std::fstream outputFile;
+    outputFile.open(output.str().c_str(), std::ios::out);
+
+    /* Output trace print */
+    if (headers)
+      {
+        outputFile << "timestamp, segmental-snr\n";
+      }
+
+    std::vector<MetricRow>::iterator iterator;
+    for (iterator = m_metric.begin(); iterator < m_metric.end(); iterator++)
+      {
+        outputFile << iterator->m_timestamp << ", " << iterator->m_snr << "\n";
+      }
+
+    outputFile.close();
+    return true;
+  }
+
+}
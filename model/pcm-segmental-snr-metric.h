@@ -0,0 +1,117 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Alessandro Paganelli <alessandro.paganelli@unimore.it>
+ *          Daniela Saladino <daniela.saladino@unimore.it>
+ */
+
+
+#ifndef PCM_SEGMENTAL_SNR_METRIC_H_
+#define PCM_SEGMENTAL_SNR_METRIC_H_
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include "ns3/wav-container.h"
+#include "ns3/metric.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/mathematics.h>
+}
+#endif
+
+namespace ns3
+{
+
+  /* Default segment length (in ms) and bounds (in dB) commonly used to clip the SNR
+   * of each segment, so that silent or perfectly received segments do not dominate
+   * the average. */
+#define _SEGMENTAL_SNR_DEFAULT_SEGMENT 20
+#define _SEGMENTAL_SNR_MIN -10.0
+#define _SEGMENTAL_SNR_MAX 35.0
+
+  /* Segmental SNR metric for G.711 mu-law audio. Samples are linearized by means of a
+   * 256-entry lookup table and compared segment by segment (e.g., 10 or 20 ms), producing
+   * one value per segment. */
+  class PcmSegmentalSnrMetric : public ns3::Metric
+  {
+  public:
+    PcmSegmentalSnrMetric();
+    PcmSegmentalSnrMetric(unsigned int segmentLength);
+
+    typedef struct MetricRow
+    {
+      unsigned long int m_timestamp;
+      double m_snr;
+    } MetricRow;
+
+    virtual bool
+    EvaluateQoe(std::string originalFilename, std::string receivedFilename);
+    virtual bool
+    PrintResults(std::string outputFilename, bool headers);
+
+    /* Segment length, in ms */
+    void
+    SetSegmentLength(unsigned int segmentLength);
+    unsigned int
+    GetSegmentLength();
+
+    double
+    GetAverageSegmentalSnr();
+
+  private:
+    unsigned int m_segmentLength;
+    unsigned int m_segmentNumTot;
+    double m_avgSnr;
+
+    /* Linear value of each mu-law encoded byte */
+    int16_t m_linearTable[256];
+
+    /* Byte buffers of the two files, plus the timestamp of the first byte
+     * stored in the original one. Both buffers are read from m_readOffset on: the
+     * bytes before it have already been compared, and are discarded only once they
+     * take more than half of the buffers. */
+    std::vector<uint8_t> m_originalBuffer;
+    std::vector<uint8_t> m_receivedBuffer;
+    unsigned int m_readOffset;
+    unsigned long int m_originalTimestamp;
+
+    /* Linearized samples of the current segment */
+    std::vector<float> m_originalSegment;
+    std::vector<float> m_receivedSegment;
+
+    std::vector<MetricRow> m_metric;
+
+    void
+    BuildLinearTable();
+
+    bool
+    FillBuffer(WavContainer* container, std::vector<uint8_t>* buffer,
+               unsigned int length, bool original);
+
+    double
+    ComputeSegmentSnr(const uint8_t* original, const uint8_t* received,
+                      unsigned int length);
+  };
+
+}
+
+#endif /* PCM_SEGMENTAL_SNR_METRIC_H_ */
@@ -23,6 +23,7 @@
 #include "ns3/header.h"
 
 #define _FIRST_TWO_BYTES 0x8000 /* Definition of the first two bytes of the header */
+#define _RTP_MARKER_BIT 0x0080 /* Marker bit within the first two bytes */
 
 namespace ns3
 {
@@ -61,6 +62,10 @@ namespace ns3
         {
           m_firstTwoBytes = _FIRST_TWO_BYTES;
         }
+      else
+        {
+          m_firstTwoBytes = 0;
+        }
     }
 
     static TypeId
@@ -114,6 +119,26 @@ namespace ns3
       m_synchronizationSource = synchronizationSource;
     }
 
+    /* The marker bit flags the last packet of an access unit (RFC 6184, sec. 5.1) */
+    bool
+    GetMarker()
+    {
+      return (m_firstTwoBytes & _RTP_MARKER_BIT) != 0;
+    }
+
+    void
+    SetMarker(bool marker)
+    {
+      if (marker)
+        {
+          m_firstTwoBytes |= _RTP_MARKER_BIT;
+        }
+      else
+        {
+          m_firstTwoBytes &= ~_RTP_MARKER_BIT;
+        }
+    }
+
   protected:
     /* The "classical" header is composed by 12 bytes. First 16 bits regard specific aspects of the
      * RTP behaviour, plus the payload type (last 7 bits). Then we have 16 bits used to carry
@@ -0,0 +1,392 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Alessandro Paganelli <alessandro.paganelli@unimore.it>
+ *          Daniela Saladino <daniela.saladino@unimore.it>
+ */
+
+
+#include <cstdio>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "schedule-packetizer.h"
+
+#define _SCHEDULE_PACKETIZER_DEBUG 0
+
+namespace ns3
+{
+
+  SchedulePacketizer::SchedulePacketizer(int mtu, SimulationDataset* simulationDataset,
+                                         std::string scheduleFilename) :
+                                         Packetizer(mtu, simulationDataset)
+  {
+    m_schedule = NULL;
+    m_scheduleSize = 0;
+    m_recordCount = 0;
+    m_maxPayloadSize = 0;
+    m_recordsOffset = 0;
+    m_nextRecord = 0;
+    m_valid = false;
+
+    int scheduleFile = open(scheduleFilename.c_str(), O_RDONLY);
+    if (scheduleFile < 0)
+      {
+        std::cout << "SchedulePacketizer: unable to open " << scheduleFilename << "\n";
+        return;
+      }
+
+    struct stat scheduleStatus;
+    if (fstat(scheduleFile, &scheduleStatus) != 0 ||
+        (size_t) scheduleStatus.st_size < sizeof(ScheduleHeader))
+      {
+        std::cout << "SchedulePacketizer: " << scheduleFilename << " is not a packet schedule\n";
+        close(scheduleFile);
+        return;
+      }
+
+    m_scheduleSize = scheduleStatus.st_size;
+    void* mapping = mmap(NULL, m_scheduleSize, PROT_READ, MAP_PRIVATE, scheduleFile, 0);
+
+    /* The mapping stays valid after the descriptor has been closed */
+    close(scheduleFile);
+
+    if (mapping == MAP_FAILED)
+      {
+        std::cout << "SchedulePacketizer: unable to map " << scheduleFilename << "\n";
+        m_scheduleSize = 0;
+        return;
+      }
+    m_schedule = (const uint8_t*) mapping;
+
+    /* The schedule is read once, from the start to the end */
+    madvise(mapping, m_scheduleSize, MADV_SEQUENTIAL);
+
+    ScheduleHeader header;
+    memcpy(&header, m_schedule, sizeof(header));
+
+    if (header.m_magic != _PACKET_SCHEDULE_MAGIC || header.m_version != _PACKET_SCHEDULE_VERSION ||
+        header.m_recordsOffset + (uint64_t) header.m_recordCount * sizeof(ScheduleRecord) !=
+        m_scheduleSize)
+      {
+        std::cout << "SchedulePacketizer: " << scheduleFilename << " is corrupted\n";
+        return;
+      }
+
+    /* The packets have been built for a given MTU and packetization mode, and they
+     * must cover the same part of the input file as the receiver expects */
+    bool windowEnabled = simulationDataset->GetSourceWindowEnabled();
+    if (header.m_mtu != m_mtu ||
+        header.m_nalAwarePacketization != (simulationDataset->GetNalAwarePacketization() ? 1U : 0U) ||
+        header.m_sourceWindowEnabled != (windowEnabled ? 1U : 0U) ||
+        (windowEnabled &&
+         (header.m_sourceWindowStart != simulationDataset->GetSourceWindowStart() ||
+          header.m_sourceWindowDuration != simulationDataset->GetSourceWindowDuration())))
+      {
+        std::cout << "SchedulePacketizer: " << scheduleFilename
+                  << " was built with different MTU, packetization mode or window\n";
+        return;
+      }
+
+    /* The schedule must also have been built from the current input file, which must
+     * not have been modified since then */
+    int64_t sourceSize = 0, sourceModificationTime = 0;
+    if (!GetSourceStatus(simulationDataset->GetOriginalCodedFile(), &sourceSize,
+                         &sourceModificationTime) ||
+        header.m_sourceSize != sourceSize ||
+        header.m_sourceModificationTime != sourceModificationTime ||
+        header.m_fileType != (uint32_t) simulationDataset->GetFileType())
+      {
+        std::cout << "SchedulePacketizer: " << scheduleFilename << " was not built from "
+                  << simulationDataset->GetOriginalCodedFile() << " or it is out of date\n";
+        return;
+      }
+
+    if (header.m_payloadBudget == 0 || header.m_maxPayloadSize > header.m_payloadBudget ||
+        header.m_payloadBudget + _IP_HEADER_LENGTH + _UDP_HEADER_LENGTH + _RTP_HEADER_LENGTH >
+        m_mtu || header.m_samplingInterval <= 0)
+      {
+        std::cout << "SchedulePacketizer: " << scheduleFilename
+                  << " has an invalid payload budget or sampling interval\n";
+        return;
+      }
+
+    m_recordCount = header.m_recordCount;
+    m_maxPayloadSize = header.m_maxPayloadSize;
+    m_recordsOffset = header.m_recordsOffset;
+
+    /* The stored payloads already respect the budget they were built with */
+    m_payloadBudget = header.m_payloadBudget;
+    m_samplingInterval = header.m_samplingInterval;
+    m_valid = true;
+  }
+
+  SchedulePacketizer::~SchedulePacketizer()
+  {
+    if (m_schedule != NULL)
+      {
+        munmap((void*) m_schedule, m_scheduleSize);
+      }
+  }
+
+  bool
+  SchedulePacketizer::GetSourceStatus(std::string filename, int64_t* size,
+                                      int64_t* modificationTime)
+  {
+    struct stat fileStatus;
+    if (stat(filename.c_str(), &fileStatus) != 0)
+      {
+        return false;
+      }
+
+    *size = fileStatus.st_size;
+    *modificationTime = fileStatus.st_mtime;
+    return true;
+  }
+
+  bool
+  SchedulePacketizer::BuildSchedule(Packetizer* packetizer, SimulationDataset* dataset,
+                                    std::string scheduleFilename)
+  {
+    /* The input file is identified by its size and modification time */
+    int64_t sourceSize = 0, sourceModificationTime = 0;
+    if (!GetSourceStatus(dataset->GetOriginalCodedFile(), &sourceSize, &sourceModificationTime))
+      {
+        std::cout << "SchedulePacketizer: unable to access " << dataset->GetOriginalCodedFile()
+                  << "\n";
+        return false;
+      }
+
+    FILE* scheduleFile = fopen(scheduleFilename.c_str(), "wb");
+    if (scheduleFile == NULL)
+      {
+        std::cout << "SchedulePacketizer: unable to create " << scheduleFilename << "\n";
+        return false;
+      }
+
+    /* The header is rewritten at the end, once the number of packets is known */
+    ScheduleHeader header;
+    memset(&header, 0, sizeof(header));
+    fwrite(&header, sizeof(header), 1, scheduleFile);
+
+    std::vector<ScheduleRecord> records;
+    std::vector<uint8_t> payload;
+    uint64_t payloadOffset = sizeof(header);
+
+    Ptr<Packet> packet;
+    while (packetizer->GetNextPacket(packet))
+      {
+        /* Only the RTP payload is stored, the RTP header is rebuilt upon replay */
+        RtpProtocol rtpHeader;
+        packet->RemoveHeader(rtpHeader);
+
+        ScheduleRecord record;
+        memset(&record, 0, sizeof(record));
+
+        record.m_payloadOffset = payloadOffset;
+        record.m_payloadSize = packet->GetSize();
+
+        payload.resize(record.m_payloadSize);
+        if (record.m_payloadSize > 0)
+          {
+            unsigned int storedSize = 0;
+            const uint8_t* storedPayload = NULL;
+            if (dataset->GetVirtualPayloads())
+              {
+                /* The packet is zero-filled, its bytes are in the payload store */
+                storedPayload = dataset->GetPacketPayload(rtpHeader.GetPacketId(), &storedSize);
+              }
+
+            if (storedPayload != NULL && storedSize == record.m_payloadSize)
+              {
+                memcpy(&payload[0], storedPayload, storedSize);
+                dataset->ReleasePacketPayloadsBefore(rtpHeader.GetPacketId() + 1);
+              }
+            else
+              {
+                packet->CopyData(&payload[0], record.m_payloadSize);
+              }
+            fwrite(&payload[0], 1, record.m_payloadSize, scheduleFile);
+          }
+        payloadOffset += record.m_payloadSize;
+
+        const PacketTraceRow& row = dataset->GetPacketTraceRow(rtpHeader.GetPacketId());
+        record.m_playbackTimestamp = row.m_playbackTimestamp;
+        record.m_decodingTimestamp = row.m_decodingTimestamp;
+        record.m_packetSize = row.m_packetSize;
+        record.m_rtpTimestamp = rtpHeader.GetPacketTimestamp();
+        record.m_numberOfFragments = row.m_numberOfFragments;
+        record.m_packetId = rtpHeader.GetPacketId();
+
+        if (rtpHeader.GetMarker())
+          {
+            record.m_flags |= _PACKET_SCHEDULE_MARKER;
+          }
+        if (record.m_payloadSize >= 2 && (payload[0] & 0x1F) == NalUnitHeader::FU_A)
+          {
+            if (payload[1] & 0x80)
+              {
+                record.m_flags |= _PACKET_SCHEDULE_FRAGMENT_START;
+              }
+            if (payload[1] & 0x40)
+              {
+                record.m_flags |= _PACKET_SCHEDULE_FRAGMENT_END;
+              }
+          }
+
+        if (record.m_payloadSize > header.m_maxPayloadSize)
+          {
+            header.m_maxPayloadSize = record.m_payloadSize;
+          }
+
+        records.push_back(record);
+      }
+
+    if (records.size() > 0)
+      {
+        fwrite(&records[0], sizeof(ScheduleRecord), records.size(), scheduleFile);
+      }
+
+    header.m_magic = _PACKET_SCHEDULE_MAGIC;
+    header.m_version = _PACKET_SCHEDULE_VERSION;
+    header.m_recordCount = records.size();
+    header.m_recordsOffset = payloadOffset;
+    header.m_samplingInterval = packetizer->GetSamplingInterval();
+    header.m_mtu = packetizer->GetMtu();
+    header.m_payloadBudget = packetizer->GetPayloadBudget();
+    header.m_nalAwarePacketization = dataset->GetNalAwarePacketization() ? 1 : 0;
+    header.m_sourceWindowEnabled = dataset->GetSourceWindowEnabled() ? 1 : 0;
+    header.m_sourceWindowStart = dataset->GetSourceWindowStart();
+    header.m_sourceWindowDuration = dataset->GetSourceWindowDuration();
+    header.m_sourceSize = sourceSize;
+    header.m_sourceModificationTime = sourceModificationTime;
+    header.m_fileType = (uint32_t) dataset->GetFileType();
+
+    fseeko(scheduleFile, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, scheduleFile);
+
+    if (ferror(scheduleFile))
+      {
+        std::cout << "SchedulePacketizer: error while writing " << scheduleFilename << "\n";
+        fclose(scheduleFile);
+        return false;
+      }
+
+    fclose(scheduleFile);
+    return true;
+  }
+
+  bool
+  SchedulePacketizer::ReadNextRecord(ScheduleRecord* record, unsigned int* packetId)
+  {
+    if (m_nextRecord >= m_recordCount)
+      {
+        /* End of the schedule */
+        return false;
+      }
+
+    /* Records are not necessarily aligned within the mapping */
+    memcpy(record, m_schedule + m_recordsOffset + (uint64_t) m_nextRecord * sizeof(ScheduleRecord),
+           sizeof(ScheduleRecord));
+    m_nextRecord++;
+
+    if (record->m_payloadOffset + record->m_payloadSize > m_recordsOffset)
+      {
+        std::cout << "SchedulePacketizer: record " << (m_nextRecord - 1) << " is corrupted\n";
+        m_nextRecord = m_recordCount;
+        return false;
+      }
+
+    PacketTraceRow currentRow;
+
+    currentRow.m_packetSize = record->m_packetSize;
+    currentRow.m_playbackTimestamp = record->m_playbackTimestamp;
+    currentRow.m_decodingTimestamp = record->m_decodingTimestamp;
+    currentRow.m_rtpTimestamp = record->m_rtpTimestamp;
+    currentRow.m_numberOfFragments = record->m_numberOfFragments;
+
+    /* Push back the trace row, obtaining its packet ID */
+    *packetId = m_simulationDataset->AppendPacketTraceRow(currentRow);
+
+#if _SCHEDULE_PACKETIZER_DEBUG
+    std::cout << "Schedule packetizer data - packetId: " << *packetId
+              << ", timestamp: " << currentRow.m_rtpTimestamp
+              << ", packet size: " << currentRow.m_packetSize << "\n";
+#endif
+
+    return true;
+  }
+
+  bool
+  SchedulePacketizer::GetNextPacket(Ptr<Packet>& packet)
+  {
+    ScheduleRecord record;
+    unsigned int packetId = 0;
+
+    if (!ReadNextRecord(&record, &packetId))
+      {
+        return false;
+      }
+
+    /* The packet is created straight from the mapped payload */
+    if (m_simulationDataset->GetVirtualPayloads())
+      {
+        uint8_t* storedPayload =
+            m_simulationDataset->AllocatePacketPayload(packetId, record.m_payloadSize);
+        if (record.m_payloadSize > 0)
+          {
+            memcpy(storedPayload, m_schedule + record.m_payloadOffset, record.m_payloadSize);
+          }
+        packet = Create<Packet>(record.m_payloadSize);
+      }
+    else
+      {
+        packet = Create<Packet>(m_schedule + record.m_payloadOffset, record.m_payloadSize);
+      }
+
+    RtpProtocol rtpHeader(RtpProtocol::UNSPECIFIED, packetId, record.m_rtpTimestamp,
+                          m_synchronizationSource);
+    rtpHeader.SetMarker((record.m_flags & _PACKET_SCHEDULE_MARKER) != 0);
+    packet->AddHeader(rtpHeader);
+
+    return true;
+  }
+
+  /* This method copies the payload of the next packet into buffer. Moreover, it
+   * fills the timestamp and the packetId, too.
+   * Returns true if everything went well, false otherwise. */
+  bool
+  SchedulePacketizer::GetNextPacket(unsigned int* packetId, unsigned long int* timestamp,
+                                    uint8_t* buffer, unsigned int* packetSize)
+  {
+    ScheduleRecord record;
+
+    if (!ReadNextRecord(&record, packetId))
+      {
+        return false;
+      }
+
+    memcpy(buffer, m_schedule + record.m_payloadOffset, record.m_payloadSize);
+    *packetSize = record.m_payloadSize;
+    *timestamp = record.m_rtpTimestamp;
+
+    return true;
+  }
+
+} // namespace ns3
@@ -0,0 +1,147 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Alessandro Paganelli <alessandro.paganelli@unimore.it>
+ *          Daniela Saladino <daniela.saladino@unimore.it>
+ */
+
+
+#ifndef SCHEDULE_PACKETIZER_H_
+#define SCHEDULE_PACKETIZER_H_
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include "stdint.h"
+#include "packetizer.h"
+#include "packet-trace-structure.h"
+
+#define _PACKET_SCHEDULE_MAGIC 0x51534348 /* "QSCH" */
+#define _PACKET_SCHEDULE_VERSION 3
+
+/* Flags of a schedule record */
+#define _PACKET_SCHEDULE_MARKER 0x01
+#define _PACKET_SCHEDULE_FRAGMENT_START 0x02
+#define _PACKET_SCHEDULE_FRAGMENT_END 0x04
+
+namespace ns3
+{
+
+  /* Packetizer replaying a packet schedule, i.e., a file storing the RTP payloads
+   * produced by another packetizer together with their packet trace rows. The schedule
+   * is built once with BuildSchedule and it is then memory-mapped, so that each packet
+   * is created straight from the mapped payload, without any demuxing.
+   *
+   * The schedule file consists of a fixed header, the payload blob and, at the end, a
+   * fixed-width record per packet. The header also stores the packetization settings
+   * the schedule was built with and the identity of the input file (size, modification
+   * time and file type): the constructor refuses a schedule whose MTU, NAL-aware mode,
+   * source window or input file differ from the current ones, and it takes the sampling
+   * interval and the payload budget from the schedule, so that the input file does not
+   * need to be opened to replay it. */
+  class SchedulePacketizer : public Packetizer
+  {
+  public:
+    typedef struct ScheduleHeader
+    {
+      uint32_t m_magic;
+      uint32_t m_version;
+      uint32_t m_recordCount;
+      uint32_t m_maxPayloadSize;
+      uint64_t m_recordsOffset;
+      double m_samplingInterval;
+      uint32_t m_mtu;
+      uint32_t m_payloadBudget;
+      uint32_t m_nalAwarePacketization;
+      uint32_t m_sourceWindowEnabled;
+      double m_sourceWindowStart;
+      double m_sourceWindowDuration;
+      int64_t m_sourceSize;
+      int64_t m_sourceModificationTime;
+      uint32_t m_fileType;
+    } ScheduleHeader;
+
+    typedef struct ScheduleRecord
+    {
+      uint64_t m_payloadOffset;
+      double m_playbackTimestamp;
+      double m_decodingTimestamp;
+      uint32_t m_payloadSize;
+      uint32_t m_packetSize;
+      uint32_t m_rtpTimestamp;
+      uint32_t m_numberOfFragments;
+      uint32_t m_packetId;
+      uint32_t m_flags;
+    } ScheduleRecord;
+
+    SchedulePacketizer(int mtu, SimulationDataset* simulationDataset,
+                       std::string scheduleFilename);
+    virtual
+    ~SchedulePacketizer();
+
+    /* Method used to drain packetizer, whose packet trace is filled into dataset, and
+     * to store all of its packets into scheduleFilename.
+     * Returns true if everything went well, false otherwise. */
+    static bool
+    BuildSchedule(Packetizer* packetizer, SimulationDataset* dataset,
+                  std::string scheduleFilename);
+
+    /* Method used to know whether the schedule has been opened and validated */
+    bool
+    IsValid()
+    {
+      return m_valid;
+    }
+
+    virtual uint32_t
+    GetPayloadLength()
+    {
+      return m_maxPayloadSize;
+    }
+
+    virtual bool
+    GetNextPacket(unsigned int* packetId, unsigned long int* timestamp,
+        uint8_t* buffer, unsigned int* packetSize);
+
+    virtual bool
+    GetNextPacket(Ptr<Packet>& packet);
+
+  private:
+    /* The mapping is owned by the packetizer, so it cannot be copied */
+    SchedulePacketizer(const SchedulePacketizer&);
+    SchedulePacketizer&
+    operator=(const SchedulePacketizer&);
+
+    /* Method used to read the next record and to push back its trace row, obtaining
+     * the packet ID of the replayed packet. Returns false at the end of the schedule. */
+    bool
+    ReadNextRecord(ScheduleRecord* record, unsigned int* packetId);
+
+    /* Method used to obtain the size and the modification time of the input file */
+    static bool
+    GetSourceStatus(std::string filename, int64_t* size, int64_t* modificationTime);
+
+    const uint8_t* m_schedule;
+    size_t m_scheduleSize;
+    uint32_t m_recordCount;
+    uint32_t m_maxPayloadSize;
+    uint64_t m_recordsOffset;
+    uint32_t m_nextRecord;
+    bool m_valid;
+  };
+
+} // namespace ns3
+
+#endif /* SCHEDULE_PACKETIZER_H_ */
@@ -0,0 +1,121 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Alessandro Paganelli <alessandro.paganelli@unimore.it>
+ *          Daniela Saladino <daniela.saladino@unimore.it>
+ */
+
+
+#include <algorithm>
+#include "segmented-memory-buffer.h"
+
+namespace ns3
+{
+
+#define _SEGMENTED_MEMORY_BUFFER_DEFAULT_SEGMENT 1048576
+
+  SegmentedMemoryBuffer::SegmentedMemoryBuffer() :
+                                               m_segments(),
+                                               m_segmentSize(_SEGMENTED_MEMORY_BUFFER_DEFAULT_SEGMENT),
+                                               m_size(0)
+  {
+  }
+
+  SegmentedMemoryBuffer::SegmentedMemoryBuffer(unsigned int segmentSize) :
+                                               m_segments(),
+                                               m_segmentSize(segmentSize > 0 ? segmentSize : 1),
+                                               m_size(0)
+  {
+  }
+
+  SegmentedMemoryBuffer::~SegmentedMemoryBuffer()
+  {
+    Clear();
+  }
+
+  void
+  SegmentedMemoryBuffer::WriteAt(uint64_t offset, const uint8_t* data, unsigned int length)
+  {
+    /* New segments are allocated as needed: the gaps left by writes beyond the end
+     * are read as zeros */
+    uint64_t end = offset + length;
+    while ((uint64_t) m_segments.size() * m_segmentSize < end)
+      {
+        uint8_t* segment = new uint8_t[m_segmentSize];
+        memset(segment, 0, m_segmentSize);
+        m_segments.push_back(segment);
+      }
+
+    while (length > 0)
+      {
+        unsigned int segmentNumber = offset / m_segmentSize;
+        unsigned int segmentOffset = offset % m_segmentSize;
+        unsigned int chunk = std::min(length, m_segmentSize - segmentOffset);
+
+        memcpy(m_segments[segmentNumber] + segmentOffset, data, chunk);
+
+        data += chunk;
+        offset += chunk;
+        length -= chunk;
+      }
+
+    m_size = std::max(m_size, end);
+  }
+
+  unsigned int
+  SegmentedMemoryBuffer::ReadAt(uint64_t offset, uint8_t* data, unsigned int length)
+  {
+    if (offset >= m_size)
+      {
+        return 0;
+      }
+
+    length = (unsigned int) std::min((uint64_t) length, m_size - offset);
+
+    unsigned int readBytes = 0;
+    while (readBytes < length)
+      {
+        unsigned int segmentNumber = offset / m_segmentSize;
+        unsigned int segmentOffset = offset % m_segmentSize;
+        unsigned int chunk = std::min(length - readBytes, m_segmentSize - segmentOffset);
+
+        memcpy(data + readBytes, m_segments[segmentNumber] + segmentOffset, chunk);
+
+        offset += chunk;
+        readBytes += chunk;
+      }
+
+    return readBytes;
+  }
+
+  uint64_t
+  SegmentedMemoryBuffer::GetSize()
+  {
+    return m_size;
+  }
+
+  void
+  SegmentedMemoryBuffer::Clear()
+  {
+    for (unsigned int i = 0; i < m_segments.size(); i++)
+      {
+        delete[] m_segments[i];
+      }
+
+    m_segments.clear();
+    m_size = 0;
+  }
+
+} // namespace ns3
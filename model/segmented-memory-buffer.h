@@ -0,0 +1,70 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Alessandro Paganelli <alessandro.paganelli@unimore.it>
+ *          Daniela Saladino <daniela.saladino@unimore.it>
+ */
+
+
+#ifndef SEGMENTED_MEMORY_BUFFER_H_
+#define SEGMENTED_MEMORY_BUFFER_H_
+
+#include <vector>
+#include <cstring>
+#include "stdint.h"
+
+namespace ns3
+{
+
+  /* Growable in-memory file, made of fixed-size segments so that growing it never moves
+   * the data already written. It supports random-access reads and writes, as required
+   * by the muxers, which go back to patch headers. */
+  class SegmentedMemoryBuffer
+  {
+  public:
+    SegmentedMemoryBuffer();
+    SegmentedMemoryBuffer(unsigned int segmentSize);
+
+    ~SegmentedMemoryBuffer();
+
+    /* Write length bytes at offset, growing the buffer if needed */
+    void
+    WriteAt(uint64_t offset, const uint8_t* data, unsigned int length);
+
+    /* Copy (up to) length bytes starting at offset into data.
+     * Returns the number of bytes actually read. */
+    unsigned int
+    ReadAt(uint64_t offset, uint8_t* data, unsigned int length);
+
+    uint64_t
+    GetSize();
+    void
+    Clear();
+
+  protected:
+    std::vector<uint8_t*> m_segments;
+    unsigned int m_segmentSize;
+    uint64_t m_size;
+
+  private:
+    /* The segments are owned by the buffer, which cannot be copied */
+    SegmentedMemoryBuffer(const SegmentedMemoryBuffer&);
+    SegmentedMemoryBuffer&
+    operator=(const SegmentedMemoryBuffer&);
+  };
+
+} // namespace ns3
+
+#endif /* SEGMENTED_MEMORY_BUFFER_H_ */
@@ -0,0 +1,187 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Alessandro Paganelli <alessandro.paganelli@unimore.it>
+ *          Daniela Saladino <daniela.saladino@unimore.it>
+ */
+
+
+#include <sstream>
+
+#include "shared-content-store.h"
+#include "mpeg4-container.h"
+#include "wav-container.h"
+
+#define _SHARED_CONTENT_STORE_DEBUG 0
+
+namespace ns3
+{
+
+  std::map<std::string, SharedContentStore*> SharedContentStore::m_registry;
+
+  Ptr<SharedContentStore>
+  SharedContentStore::Get(SimulationDataset* dataset, enum AVMediaType type)
+  {
+    std::ostringstream key;
+    key << dataset->GetOriginalCodedFile() << ":" << (int) type;
+    if (dataset->GetSourceWindowEnabled())
+      {
+        key << ":" << dataset->GetSourceWindowStart() << ":" << dataset->GetSourceWindowDuration();
+      }
+
+    std::map<std::string, SharedContentStore*>::iterator it = m_registry.find(key.str());
+    if (it != m_registry.end())
+      {
+        return Ptr<SharedContentStore>(it->second);
+      }
+
+    Container* container = NULL;
+    if (type == AVMEDIA_TYPE_AUDIO)
+      {
+        container = new WavContainer(dataset->GetOriginalCodedFile(), Container::READ, type);
+      }
+    else
+      {
+        container = new Mpeg4Container(dataset->GetOriginalCodedFile(), Container::READ, type);
+      }
+
+    if (dataset->GetUseContainerIndex())
+      {
+        container->EnableIndex();
+      }
+    if (dataset->GetSourceWindowEnabled())
+      {
+        container->SetWindow(dataset->GetSourceWindowStart(), dataset->GetSourceWindowDuration());
+      }
+
+    if (!container->InitForRead())
+      {
+        std::cout << "SharedContentStore: unable to read " << dataset->GetOriginalCodedFile() << "\n";
+        delete container;
+        return Ptr<SharedContentStore>();
+      }
+
+    return Ptr<SharedContentStore>(new SharedContentStore(key.str(),
+                                                          dataset->GetOriginalCodedFile(),
+                                                          type, container), false);
+  }
+
+  SharedContentStore::SharedContentStore(std::string key, std::string filename,
+                                         enum AVMediaType type, Container* container)
+  {
+    m_key = key;
+    m_filename = filename;
+    m_type = type;
+    m_container = container;
+
+    /* The whole stream is demuxed here, once */
+    AVPacket readFrame;
+    while (m_container->GetNextPacket(&readFrame))
+      {
+        StoredPacket packet;
+
+        packet.m_offset = m_payload.size();
+        packet.m_pts = readFrame.pts;
+        packet.m_dts = readFrame.dts;
+        packet.m_size = readFrame.size;
+        packet.m_flags = readFrame.flags;
+        packet.m_duration = readFrame.duration;
+
+        m_payload.insert(m_payload.end(), readFrame.data, readFrame.data + readFrame.size);
+        m_packets.push_back(packet);
+
+        av_free_packet(&readFrame);
+      }
+
+#if _SHARED_CONTENT_STORE_DEBUG
+    std::cout << "SharedContentStore: " << m_key << " demuxed, " << m_packets.size()
+              << " packets, " << m_payload.size() << " bytes\n";
+#endif
+
+    m_registry[m_key] = this;
+  }
+
+  SharedContentStore::~SharedContentStore()
+  {
+    m_registry.erase(m_key);
+    delete m_container;
+  }
+
+  SharedContentContainer::SharedContentContainer(Ptr<SharedContentStore> store) :
+    Container(store->GetFilename(), READ, store->GetType())
+  {
+    m_store = store;
+    m_nextPacket = 0;
+  }
+
+  bool
+  SharedContentContainer::InitForRead()
+  {
+    Container* source = m_store->GetContainer();
+
+    m_inputCodecContext = source->GetCodecContext();
+    m_copyStream = source->GetStream();
+    m_timeUnit = source->GetSamplingInterval();
+    m_sampleRate = 1/m_timeUnit;
+    m_streamNumber = m_copyStream.index;
+    m_nextPacket = 0;
+
+    return true;
+  }
+
+  bool
+  SharedContentContainer::InitForWrite()
+  {
+    std::cout << "SharedContentContainer: the shared content cannot be written\n";
+    return false;
+  }
+
+  bool
+  SharedContentContainer::GetNextPacket(AVPacket* readFrame)
+  {
+    if (m_nextPacket >= m_store->GetPacketCount())
+      {
+        return false;
+      }
+
+    const SharedContentStore::StoredPacket& packet = m_store->GetPacket(m_nextPacket);
+    m_nextPacket++;
+
+    /* No destructor is set, so that the shared payload is never released */
+    av_init_packet(readFrame);
+    readFrame->data = m_store->GetPayload(packet);
+    readFrame->size = packet.m_size;
+    readFrame->pts = packet.m_pts;
+    readFrame->dts = packet.m_dts;
+    readFrame->flags = packet.m_flags;
+    readFrame->duration = packet.m_duration;
+    readFrame->stream_index = m_streamNumber;
+
+    return true;
+  }
+
+  bool
+  SharedContentContainer::FinalizeFile()
+  {
+    return true;
+  }
+
+  bool
+  SharedContentContainer::PacketizeFromQueue()
+  {
+    return false;
+  }
+
+} // namespace ns3
@@ -0,0 +1,156 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Alessandro Paganelli <alessandro.paganelli@unimore.it>
+ *          Daniela Saladino <daniela.saladino@unimore.it>
+ */
+
+
+#ifndef SHARED_CONTENT_STORE_H_
+#define SHARED_CONTENT_STORE_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include "stdint.h"
+#include "ns3/ptr.h"
+#include "ns3/simple-ref-count.h"
+#include "container.h"
+#include "simulation-dataset.h"
+
+namespace ns3
+{
+
+  /* Content of a multimedia file demuxed once and kept in memory, shared by all the
+   * flows streaming it. Stores are refcounted and registered by file, stream type and
+   * source window: Get returns the existing store if any, so that N senders of the same
+   * clip pay for a single demux and a single copy of the payloads. The store is released
+   * when its last user goes away. Each flow reads the store through its own cursor:
+   *
+   *      Ptr<SharedContentStore> store = SharedContentStore::Get(dataset, AVMEDIA_TYPE_VIDEO);
+   *      SharedContentContainer cursor(store);
+   *      cursor.InitForRead();
+   *      H264Packetizer packetizer(mtu, flowDataset, &cursor);
+   *      packetizer.SetSynchronizationSource(flowId);
+   */
+  class SharedContentStore : public SimpleRefCount<SharedContentStore>
+  {
+  public:
+    /* Demuxed packet, whose payload is stored at m_offset in the payload blob */
+    typedef struct StoredPacket
+    {
+      uint64_t m_offset;
+      int64_t m_pts;
+      int64_t m_dts;
+      uint32_t m_size;
+      int32_t m_flags;
+      int32_t m_duration;
+    } StoredPacket;
+
+    /* Method used to obtain the store of the original coded file of dataset (with its
+     * index and source window settings), demuxing the file if it is not shared yet.
+     * Returns a null pointer if the file cannot be read. */
+    static Ptr<SharedContentStore>
+    Get(SimulationDataset* dataset, enum AVMediaType type);
+
+    /* The container is owned (and has already been initialized for reading) */
+    SharedContentStore(std::string key, std::string filename, enum AVMediaType type,
+                       Container* container);
+    ~SharedContentStore();
+
+    std::string
+    GetFilename()
+    {
+      return m_filename;
+    }
+
+    enum AVMediaType
+    GetType()
+    {
+      return m_type;
+    }
+
+    Container*
+    GetContainer()
+    {
+      return m_container;
+    }
+
+    unsigned int
+    GetPacketCount()
+    {
+      return m_packets.size();
+    }
+
+    const StoredPacket&
+    GetPacket(unsigned int packetNumber)
+    {
+      return m_packets[packetNumber];
+    }
+
+    uint8_t*
+    GetPayload(const StoredPacket& packet)
+    {
+      return &m_payload[packet.m_offset];
+    }
+
+  private:
+    SharedContentStore(const SharedContentStore&);
+    SharedContentStore&
+    operator=(const SharedContentStore&);
+
+    /* Stores currently alive, by key */
+    static std::map<std::string, SharedContentStore*> m_registry;
+
+    std::string m_key;
+    std::string m_filename;
+    enum AVMediaType m_type;
+    Container* m_container;
+    std::vector<StoredPacket> m_packets;
+    std::vector<uint8_t> m_payload;
+  };
+
+  /* Read-only cursor over a SharedContentStore, usable wherever a Container is expected
+   * (e.g., as the source container of a packetizer). Each cursor keeps its own position,
+   * and the packets it returns point straight into the shared payloads. */
+  class SharedContentContainer : public ns3::Container
+  {
+  public:
+    SharedContentContainer(Ptr<SharedContentStore> store);
+
+    /* Method used to copy the stream parameters from the store and to rewind the cursor */
+    virtual bool
+    InitForRead();
+    virtual bool
+    InitForWrite();
+
+    /* The returned packet does not own its data: av_free_packet is still allowed */
+    virtual bool
+    GetNextPacket(AVPacket* readFrame);
+
+    virtual bool
+    FinalizeFile();
+
+  protected:
+    virtual bool
+    PacketizeFromQueue();
+
+    Ptr<SharedContentStore> m_store;
+    unsigned int m_nextPacket;
+  };
+
+} // namespace ns3
+
+#endif /* SHARED_CONTENT_STORE_H_ */
@@ -20,6 +20,7 @@
 // FIXME: maybe this file is useless, because of the definition of each function
 // in the header file itself.
 
+#include <cstdlib>
 #include "simulation-dataset.h"
 
 namespace ns3
@@ -29,16 +30,43 @@ namespace ns3
   {
     m_packetSent = 0;
     m_packetReceived = 0;
+    m_nextPacketId = 0;
     m_samplingInterval = 0;
+    m_useContainerIndex = false;
+    m_nalAwarePacketization = false;
+    m_virtualPayloads = false;
+    m_firstStoredPayload = 0;
+
+    m_sourceWindowEnabled = false;
+    m_sourceWindowStart = 0;
+    m_sourceWindowDuration = 0;
+    m_receiverAttached = false;
 
     /* As default, the file type is VIDEO */
     m_fileType = VIDEO;
   }
 
+  SimulationDataset::~SimulationDataset()
+  {
+    for (unsigned int i = 0; i < m_payloads.size(); i++)
+      {
+        free(m_payloads[i]);
+      }
+  }
+
   void
   SimulationDataset::SetFileType(SimulationDataset::FileType type)
   {
     m_fileType = type;
+
+    if (m_fileType == AUDIO && m_sourceWindowEnabled)
+      {
+        /* The audio metrics compare the whole original file (see SetSourceWindow) */
+        std::cout << "SimulationDataset: Source window ignored for audio files\n";
+        m_sourceWindowEnabled = false;
+        m_sourceWindowStart = 0;
+        m_sourceWindowDuration = 0;
+      }
   }
 
   SimulationDataset::FileType
@@ -117,29 +145,75 @@ namespace ns3
   SimulationDataset::PushBackPacketTraceRow(PacketTraceRow traceRow)
   {
     m_packetTrace.push_back(traceRow);
+
+    /* The allocator keeps following the IDs assigned by the caller */
+    if (traceRow.m_packetId >= m_nextPacketId)
+      {
+        m_nextPacketId = traceRow.m_packetId + 1;
+      }
+  }
+
+  unsigned int
+  SimulationDataset::AppendPacketTraceRow(PacketTraceRow traceRow)
+  {
+    traceRow.m_packetId = m_nextPacketId++;
+    m_packetTrace.push_back(traceRow);
+
+    return traceRow.m_packetId;
   }
 
-  std::vector<PacketTraceRow>
+  const std::vector<PacketTraceRow>&
   SimulationDataset::GetPacketTrace()
   {
     return m_packetTrace;
   }
 
+  const PacketTraceRow&
+  SimulationDataset::GetPacketTraceRow(unsigned int packetId)
+  {
+    return m_packetTrace[packetId];
+  }
+
+  unsigned int
+  SimulationDataset::GetPacketTraceSize()
+  {
+    return m_packetTrace.size();
+  }
+
   void
   SimulationDataset::PushBackSenderTraceRow(SenderTraceRow traceRow)
   {
     m_senderTrace.push_back(traceRow);
 
+    /* I also store the sending time, indexed by packetId */
+    if (traceRow.m_packetId >= m_senderTimestamp.size())
+      {
+        m_senderTimestamp.resize(traceRow.m_packetId + 1, -1.0);
+      }
+    m_senderTimestamp[traceRow.m_packetId] = traceRow.m_senderTimestamp;
+
     /* I also increase by one the number of packet sent */
     m_packetSent++;
   }
 
-  std::vector<SenderTraceRow>
+  const std::vector<SenderTraceRow>&
   SimulationDataset::GetSenderTrace()
   {
     return m_senderTrace;
   }
 
+  const SenderTraceRow&
+  SimulationDataset::GetSenderTraceRow(unsigned int index)
+  {
+    return m_senderTrace[index];
+  }
+
+  unsigned int
+  SimulationDataset::GetSenderTraceSize()
+  {
+    return m_senderTrace.size();
+  }
+
   void
   SimulationDataset::PushBackReceiverTraceRow(ReceiverTraceRow traceRow)
   {
@@ -149,45 +223,109 @@ namespace ns3
     m_packetReceived++;
   }
 
-  std::vector<ReceiverTraceRow>
+  const std::vector<ReceiverTraceRow>&
   SimulationDataset::GetReceiverTrace()
   {
     return m_receiverTrace;
   }
 
+  const ReceiverTraceRow&
+  SimulationDataset::GetReceiverTraceRow(unsigned int index)
+  {
+    return m_receiverTrace[index];
+  }
+
+  unsigned int
+  SimulationDataset::GetReceiverTraceSize()
+  {
+    return m_receiverTrace.size();
+  }
+
   void
   SimulationDataset::PushBackJitterTraceRow(JitterTraceRow traceRow)
   {
     m_jitterTrace.push_back(traceRow);
   }
 
-  std::vector<JitterTraceRow>
+  const std::vector<JitterTraceRow>&
   SimulationDataset::GetJitterTrace()
   {
     return m_jitterTrace;
   }
 
+  const JitterTraceRow&
+  SimulationDataset::GetJitterTraceRow(unsigned int index)
+  {
+    return m_jitterTrace[index];
+  }
+
+  unsigned int
+  SimulationDataset::GetJitterTraceSize()
+  {
+    return m_jitterTrace.size();
+  }
+
+  void
+  SimulationDataset::PushBackFrameTraceRow(FrameTraceRow traceRow)
+  {
+    m_frameTrace.push_back(traceRow);
+  }
+
+  const std::vector<FrameTraceRow>&
+  SimulationDataset::GetFrameTrace()
+  {
+    return m_frameTrace;
+  }
+
+  void
+  SimulationDataset::PushBackEModelTraceRow(EModelTraceRow traceRow)
+  {
+    m_eModelTrace.push_back(traceRow);
+  }
+
+  const std::vector<EModelTraceRow>&
+  SimulationDataset::GetEModelTrace()
+  {
+    return m_eModelTrace;
+  }
+
+  double
+  SimulationDataset::GetSenderTimestamp(unsigned int packetId)
+  {
+    if (packetId >= m_senderTimestamp.size())
+      {
+        return -1.0;
+      }
+
+    return m_senderTimestamp[packetId];
+  }
+
   void
   SimulationDataset::PrintTraces(bool headers)
   {
     /* Define filenames */
     std::stringstream packetTraceFilename, senderTraceFilename,
-        receiverTraceFilename, jitterTraceFilename;
+        receiverTraceFilename, jitterTraceFilename, frameTraceFilename,
+        eModelTraceFilename;
 
     packetTraceFilename << m_traceFileId << "-packet.csv";
     senderTraceFilename << m_traceFileId << "-sender.csv";
     receiverTraceFilename << m_traceFileId << "-receiver.csv";
     jitterTraceFilename << m_traceFileId << "-jitter.csv";
+    frameTraceFilename << m_traceFileId << "-frame.csv";
+    eModelTraceFilename << m_traceFileId << "-emodel.csv";
 
     /* Open output streams
      * FIXME: no check has been performed! Assert everything! */
     std::fstream packetTraceFile, senderTraceFile, receiverTraceFile,
-        jitterTraceFile;
+        jitterTraceFile, frameTraceFile, eModelTraceFile;
 
     packetTraceFile.open(packetTraceFilename.str().c_str(), std::ios::out);
     senderTraceFile.open(senderTraceFilename.str().c_str(), std::ios::out);
     receiverTraceFile.open(receiverTraceFilename.str().c_str(), std::ios::out);
     jitterTraceFile.open(jitterTraceFilename.str().c_str(), std::ios::out);
+    frameTraceFile.open(frameTraceFilename.str().c_str(), std::ios::out);
+    eModelTraceFile.open(eModelTraceFilename.str().c_str(), std::ios::out);
 
     /* If "headers" is true I print also the header of each file */
     if (headers)
@@ -197,6 +335,11 @@ namespace ns3
         senderTraceFile << "packetId, timestamp\n";
         receiverTraceFile << "packetId, timestamp\n";
         jitterTraceFile << "receptionTime, packetId, jitter\n";
+        frameTraceFile << "rtp-timestamp, firstPacketId, lastPacketId, fragments, "
+                       << "received-fragments, first-byte-delay, last-byte-delay, "
+                       << "completion-time\n";
+        eModelTraceFile << "time, packet-loss, burst-ratio, discarded, one-way-delay, "
+                        << "r-factor, mos\n";
       }
 
     /* Packet trace print */
@@ -235,11 +378,33 @@ namespace ns3
                         << jIterator->m_jitter << "\n";
       }
 
+    /* Frame trace print */
+    std::vector<FrameTraceRow>::iterator fIterator;
+    for (fIterator = m_frameTrace.begin(); fIterator < m_frameTrace.end(); fIterator++)
+      {
+        frameTraceFile << fIterator->m_rtpTimestamp << ", " << fIterator->m_firstPacketId << ", "
+                       << fIterator->m_lastPacketId << ", " << fIterator->m_numberOfFragments << ", "
+                       << fIterator->m_receivedFragments << ", " << fIterator->m_firstByteDelay << ", "
+                       << fIterator->m_lastByteDelay << ", " << fIterator->m_completionTime << "\n";
+      }
+
+    /* E-model trace print */
+    std::vector<EModelTraceRow>::iterator eIterator;
+    for (eIterator = m_eModelTrace.begin(); eIterator < m_eModelTrace.end(); eIterator++)
+      {
+        eModelTraceFile << eIterator->m_time << ", " << eIterator->m_packetLoss << ", "
+                        << eIterator->m_burstRatio << ", " << eIterator->m_discardedPackets << ", "
+                        << eIterator->m_oneWayDelay << ", " << eIterator->m_rFactor << ", "
+                        << eIterator->m_mos << "\n";
+      }
+
     /* Close output streams */
     packetTraceFile.close();
     senderTraceFile.close();
     receiverTraceFile.close();
     jitterTraceFile.close();
+    frameTraceFile.close();
+    eModelTraceFile.close();
   }
 
   void
@@ -300,6 +465,38 @@ namespace ns3
         std::cout << jIterator->m_receptionTime << ", " << jIterator->m_packetId << ", " 
                   << jIterator->m_jitter << "\n";
       }
+
+    /* Frame trace print */
+    if (headers)
+      {
+        std::cout << "Frame trace: rtp-timestamp, firstPacketId, lastPacketId, fragments, "
+                  << "received-fragments, first-byte-delay, last-byte-delay, completion-time\n";
+      }
+
+    std::vector<FrameTraceRow>::iterator fIterator;
+    for (fIterator = m_frameTrace.begin(); fIterator < m_frameTrace.end(); fIterator++)
+      {
+        std::cout << fIterator->m_rtpTimestamp << ", " << fIterator->m_firstPacketId << ", "
+                  << fIterator->m_lastPacketId << ", " << fIterator->m_numberOfFragments << ", "
+                  << fIterator->m_receivedFragments << ", " << fIterator->m_firstByteDelay << ", "
+                  << fIterator->m_lastByteDelay << ", " << fIterator->m_completionTime << "\n";
+      }
+
+    /* E-model trace print */
+    if (headers)
+      {
+        std::cout << "E-model trace: time, packet-loss, burst-ratio, discarded, one-way-delay, "
+                  << "r-factor, mos\n";
+      }
+
+    std::vector<EModelTraceRow>::iterator eIterator;
+    for (eIterator = m_eModelTrace.begin(); eIterator < m_eModelTrace.end(); eIterator++)
+      {
+        std::cout << eIterator->m_time << ", " << eIterator->m_packetLoss << ", "
+                  << eIterator->m_burstRatio << ", " << eIterator->m_discardedPackets << ", "
+                  << eIterator->m_oneWayDelay << ", " << eIterator->m_rFactor << ", "
+                  << eIterator->m_mos << "\n";
+      }
   }
 
   unsigned int
@@ -326,4 +523,144 @@ namespace ns3
     return m_samplingInterval;
   }
 
+  void
+  SimulationDataset::SetUseContainerIndex(bool useIndex)
+  {
+    m_useContainerIndex = useIndex;
+  }
+
+  bool
+  SimulationDataset::GetUseContainerIndex()
+  {
+    return m_useContainerIndex;
+  }
+
+  void
+  SimulationDataset::SetNalAwarePacketization(bool nalAware)
+  {
+    m_nalAwarePacketization = nalAware;
+  }
+
+  bool
+  SimulationDataset::GetNalAwarePacketization()
+  {
+    return m_nalAwarePacketization;
+  }
+
+  void
+  SimulationDataset::SetVirtualPayloads(bool virtualPayloads)
+  {
+    m_virtualPayloads = virtualPayloads;
+  }
+
+  bool
+  SimulationDataset::GetVirtualPayloads()
+  {
+    return m_virtualPayloads;
+  }
+
+  uint8_t*
+  SimulationDataset::AllocatePacketPayload(unsigned int packetId, unsigned int size)
+  {
+    if (packetId >= m_payloads.size())
+      {
+        m_payloads.resize(packetId + 1, NULL);
+        m_payloadSize.resize(packetId + 1, 0);
+      }
+
+    free(m_payloads[packetId]);
+    m_payloads[packetId] = (size > 0) ? (uint8_t*) malloc(size) : NULL;
+    m_payloadSize[packetId] = size;
+
+    return m_payloads[packetId];
+  }
+
+  const uint8_t*
+  SimulationDataset::GetPacketPayload(unsigned int packetId, unsigned int* size)
+  {
+    if (packetId >= m_payloads.size() || m_payloads[packetId] == NULL)
+      {
+        *size = 0;
+        return NULL;
+      }
+
+    *size = m_payloadSize[packetId];
+    return m_payloads[packetId];
+  }
+
+  void
+  SimulationDataset::ReleasePacketPayload(unsigned int packetId)
+  {
+    if (packetId < m_payloads.size())
+      {
+        free(m_payloads[packetId]);
+        m_payloads[packetId] = NULL;
+        m_payloadSize[packetId] = 0;
+      }
+  }
+
+  void
+  SimulationDataset::ReleasePacketPayloadsBefore(unsigned int packetId)
+  {
+    if (packetId > m_payloads.size())
+      {
+        packetId = m_payloads.size();
+      }
+
+    /* I only walk the packets which have not been released by this method yet */
+    for (; m_firstStoredPayload < packetId; m_firstStoredPayload++)
+      {
+        free(m_payloads[m_firstStoredPayload]);
+        m_payloads[m_firstStoredPayload] = NULL;
+        m_payloadSize[m_firstStoredPayload] = 0;
+      }
+  }
+
+  bool
+  SimulationDataset::SetSourceWindow(double startOffset, double duration)
+  {
+    /* The audio metrics compare the received signal with the whole original file,
+     * and they cannot be restricted to a window */
+    if (m_fileType == AUDIO)
+      {
+        std::cout << "SimulationDataset: Cannot transmit a window of an audio file\n";
+        return false;
+      }
+
+    m_sourceWindowEnabled = true;
+    m_sourceWindowStart = startOffset;
+    m_sourceWindowDuration = duration;
+    return true;
+  }
+
+  bool
+  SimulationDataset::GetSourceWindowEnabled()
+  {
+    return m_sourceWindowEnabled;
+  }
+
+  double
+  SimulationDataset::GetSourceWindowStart()
+  {
+    return m_sourceWindowStart;
+  }
+
+  double
+  SimulationDataset::GetSourceWindowDuration()
+  {
+    return m_sourceWindowDuration;
+  }
+
+  bool
+  SimulationDataset::AttachReceiver()
+  {
+    if (m_receiverAttached)
+      {
+        return false;
+      }
+
+    m_receiverAttached = true;
+    return true;
+  }
+
 } // namespace ns3
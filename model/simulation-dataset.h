@@ -51,6 +51,9 @@ namespace ns3
 
     SimulationDataset();
 
+    /* The payloads still stored in the virtual payload mode are released */
+    ~SimulationDataset();
+
     void
     SetFileType(enum FileType type);
 
@@ -81,23 +84,60 @@ namespace ns3
     void
     SetTraceFileId(std::string filename);
 
-    /* Trace structures methods */
+    /* Trace structures methods
+     * The traces are returned by const reference and are never copied: the returned
+     * references are valid until the next row is pushed to the same trace. Rows can
+     * also be accessed by index (for the packet trace, the index is the packetId). */
     void
     PushBackPacketTraceRow(PacketTraceRow traceRow);
-    std::vector<PacketTraceRow>
+
+    /* Method used to append a row to the packet trace, assigning it the next packet ID,
+     * which is returned. Packet IDs are allocated by the dataset in constant time. */
+    unsigned int
+    AppendPacketTraceRow(PacketTraceRow traceRow);
+    const std::vector<PacketTraceRow>&
     GetPacketTrace();
+    const PacketTraceRow&
+    GetPacketTraceRow(unsigned int packetId);
+    unsigned int
+    GetPacketTraceSize();
     void
     PushBackSenderTraceRow(SenderTraceRow traceRow);
-    std::vector<SenderTraceRow>
+    const std::vector<SenderTraceRow>&
     GetSenderTrace();
+    const SenderTraceRow&
+    GetSenderTraceRow(unsigned int index);
+    unsigned int
+    GetSenderTraceSize();
     void
     PushBackReceiverTraceRow(ReceiverTraceRow traceRow);
-    std::vector<ReceiverTraceRow>
+    const std::vector<ReceiverTraceRow>&
     GetReceiverTrace();
+    const ReceiverTraceRow&
+    GetReceiverTraceRow(unsigned int index);
+    unsigned int
+    GetReceiverTraceSize();
     void
     PushBackJitterTraceRow(JitterTraceRow traceRow);
-    std::vector<JitterTraceRow>
+    const std::vector<JitterTraceRow>&
     GetJitterTrace();
+    const JitterTraceRow&
+    GetJitterTraceRow(unsigned int index);
+    unsigned int
+    GetJitterTraceSize();
+    void
+    PushBackFrameTraceRow(FrameTraceRow traceRow);
+    const std::vector<FrameTraceRow>&
+    GetFrameTrace();
+    void
+    PushBackEModelTraceRow(EModelTraceRow traceRow);
+    const std::vector<EModelTraceRow>&
+    GetEModelTrace();
+
+    /* Method used to obtain the time at which the packet identified by packetId has been
+     * sent. Returns a negative value if the packet has not been sent yet. */
+    double
+    GetSenderTimestamp(unsigned int packetId);
 
     /* Trace print methods
      * If true is passed, this will print also the headers describing the content
@@ -117,6 +157,66 @@ namespace ns3
     float
     GetSamplingInterval();
 
+    /* Methods used to let the packetizers read the original file through its
+     * persistent packet index (see Container::EnableIndex) */
+    void
+    SetUseContainerIndex(bool useIndex);
+    bool
+    GetUseContainerIndex();
+
+    /* Methods used to packetize the H.264 stream as RFC 6184 single NAL unit, STAP-A
+     * and FU-A packets, instead of sending each access unit as a single NAL unit */
+    void
+    SetNalAwarePacketization(bool nalAware);
+    bool
+    GetNalAwarePacketization();
+
+    /* Methods used to enable the virtual payload mode: the packets travel with
+     * zero-filled payloads of the right size, while the actual RTP payloads are kept
+     * here, indexed by packet ID, and fetched by the receiver upon reception */
+    void
+    SetVirtualPayloads(bool virtualPayloads);
+    bool
+    GetVirtualPayloads();
+
+    /* Method used to reserve size bytes for the RTP payload of packetId. Each payload
+     * has its own allocation, so the returned pointer stays valid until the payload
+     * is released. */
+    uint8_t*
+    AllocatePacketPayload(unsigned int packetId, unsigned int size);
+
+    /* Method used to obtain the RTP payload stored for packetId (NULL if missing or
+     * released), valid until the payload is released */
+    const uint8_t*
+    GetPacketPayload(unsigned int packetId, unsigned int* size);
+
+    /* Methods used to release the payload of packetId once it has been consumed (or
+     * declared lost) by the receiver, and the payloads of all the packets preceding
+     * packetId, e.g., at the end of the reception. Releasing a missing payload does
+     * nothing. */
+    void
+    ReleasePacketPayload(unsigned int packetId);
+    void
+    ReleasePacketPayloadsBefore(unsigned int packetId);
+
+    /* Methods used to let the packetizers transmit only the window of the original
+     * file of duration seconds starting at startOffset (see Container::SetWindow).
+     * Windows are refused for AUDIO files, whose metrics compare the whole file. */
+    bool
+    SetSourceWindow(double startOffset, double duration);
+    bool
+    GetSourceWindowEnabled();
+    double
+    GetSourceWindowStart();
+    double
+    GetSourceWindowDuration();
+
+    /* Method called by a receiver to take the dataset: the traces, packet IDs and
+     * payloads it holds refer to a single stream, so a dataset cannot be shared by two
+     * receivers. Returns false if another receiver has already taken it. */
+    bool
+    AttachReceiver();
+
   protected:
     // TODO: check the class' attributes
     std::string m_originalRawFile;
@@ -130,9 +230,18 @@ namespace ns3
     // FIXME: Are they pointers or are they used directly by codec and packetizer?
     //        Now are used as variables, because we use copy constructor.
     std::vector<PacketTraceRow> m_packetTrace;
+
+    /* Next packet ID to be assigned */
+    unsigned int m_nextPacketId;
     std::vector<SenderTraceRow> m_senderTrace;
     std::vector<ReceiverTraceRow> m_receiverTrace;
     std::vector<JitterTraceRow> m_jitterTrace;
+    std::vector<FrameTraceRow> m_frameTrace;
+    std::vector<EModelTraceRow> m_eModelTrace;
+
+    /* Sending time of each packet, indexed by packetId, used to compute delays
+     * at the receiver side without scanning the sender trace */
+    std::vector<double> m_senderTimestamp;
 
     /* Variables used to store some useful statistics */
     unsigned int m_packetSent;
@@ -141,6 +250,28 @@ namespace ns3
     /* The sampling interval */
     float m_samplingInterval;
     enum FileType m_fileType;
+
+    bool m_useContainerIndex;
+    bool m_nalAwarePacketization;
+
+    /* Payload store used by the virtual payload mode: the RTP payloads and their sizes,
+     * indexed by packetId. Payloads preceding m_firstStoredPayload have all been released. */
+    bool m_virtualPayloads;
+    std::vector<uint8_t*> m_payloads;
+    std::vector<uint32_t> m_payloadSize;
+    unsigned int m_firstStoredPayload;
+
+    bool m_sourceWindowEnabled;
+    double m_sourceWindowStart;
+    double m_sourceWindowDuration;
+
+    bool m_receiverAttached;
+
+  private:
+    /* The stored payloads are owned by the dataset, which cannot be copied */
+    SimulationDataset(const SimulationDataset&);
+    SimulationDataset&
+    operator=(const SimulationDataset&);
   };
 
 } // namespace ns3
@@ -76,6 +76,10 @@ namespace ns3
         return false;
       }
 
+    //skip the frames of the original file preceding the reference window
+    if (m_referenceFirstFrame > 0)
+      fseeko(originalFile, (off_t) m_referenceFirstFrame * size, SEEK_SET);
+
     unsigned char * originalFrame = (unsigned char*) calloc(size, sizeof(unsigned char));
     assert(originalFrame != NULL);
 
@@ -84,6 +88,10 @@ namespace ns3
 
     for(;;) //infinite cicle to read until the end of the file
       {
+        //stop at the end of the reference window, if any
+        if(m_referenceFrameCount > 0 && m_frameNumTot >= m_referenceFrameCount)
+          break;
+
         //read the frame from the original file
         if(1 != (fread (originalFrame, size, 1, originalFile)))
           break;
@@ -101,7 +109,7 @@ namespace ns3
         MetricRow currentRow;
 
         //fill the metric row
-        currentRow.m_frameNum=m_frameNumTot;
+        currentRow.m_frameNum=m_referenceFirstFrame + m_frameNumTot;
         currentRow.m_ssim=ssim_frame;
 
         //put the currentRow into the result vector
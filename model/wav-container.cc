@@ -142,7 +142,18 @@ namespace ns3
 
         av_dump_format(m_outputFormatContext, 0, m_filename.c_str(), 1);
 
-        if (!(m_outputFormat->flags & AVFMT_NOFILE))
+        if (UsesCustomIo())
+          {
+            /* The muxer writes into memory, or to the writer thread, through the
+             * custom I/O context */
+            if (!OpenCustomIo(true))
+              {
+                std::cout << "WavContainer: Could not open custom output\n";
+                return false;
+              }
+            m_outputFormatContext->pb = m_customIoContext;
+          }
+        else if (!(m_outputFormat->flags & AVFMT_NOFILE))
           {
             if (url_fopen(&m_outputFormatContext->pb, m_filename.c_str(), AVIO_FLAG_WRITE)
                 < 0)
@@ -182,34 +193,26 @@ namespace ns3
         m_rtpHeaderQueue.pop();
         m_packetLengthQueue.pop();
 
-        for (unsigned int i = 0; i < packetSize; i++)
-          {
-            m_timestampQueue.push(currentTimestamp);
-            currentTimestamp++;
-          }
+        /* The timestamp of each byte of the packet is derived from the first one */
+        TimestampRun run;
+        run.m_timestamp = currentTimestamp;
+        run.m_length = packetSize;
+        m_timestampQueue.push(run);
       }
 
     /* Now I should have a filled timestamp queue.
      * Now I have to verify if there is enough data to create an output frame */
-    while (m_packetizationQueue.size() >= _WAV_FRAME_SIZE)
+    while (m_packetizationBuffer.GetSize() >= _WAV_FRAME_SIZE)
       {
         AVPacket outputFrame;
         av_init_packet(&outputFrame);
 
         outputFrame.size = _WAV_FRAME_SIZE;
-        outputFrame.dts = m_timestampQueue.front();
+        outputFrame.dts = GetNextTimestamp();
         outputFrame.pts = outputFrame.dts;
 
-        uint8_t tempBuffer[_WAV_FRAME_SIZE];
-
-        for (unsigned int i = 0; i < _WAV_FRAME_SIZE; i++)
-          {
-            tempBuffer[i] = m_packetizationQueue.front();
-            m_packetizationQueue.pop();
-            m_timestampQueue.pop();
-          }
-
-        outputFrame.data = tempBuffer;
+        outputFrame.data = (uint8_t*) ReadPacketizationData(_WAV_FRAME_SIZE);
+        ConsumeTimestamps(_WAV_FRAME_SIZE);
 
         /* Now I have to export the packet to the output context */
         if (av_interleaved_write_frame(m_outputFormatContext, &outputFrame)
@@ -224,6 +227,37 @@ namespace ns3
     return true;
   }
 
+  unsigned long int
+  WavContainer::GetNextTimestamp()
+  {
+    if (m_timestampQueue.size() == 0)
+      {
+        return 0;
+      }
+
+    return m_timestampQueue.front().m_timestamp;
+  }
+
+  void
+  WavContainer::ConsumeTimestamps(unsigned int length)
+  {
+    while (length > 0 && m_timestampQueue.size() > 0)
+      {
+        TimestampRun& currentRun = m_timestampQueue.front();
+
+        if (currentRun.m_length > length)
+          {
+            /* Only part of the run is consumed */
+            currentRun.m_timestamp += length;
+            currentRun.m_length -= length;
+            return;
+          }
+
+        length -= currentRun.m_length;
+        m_timestampQueue.pop();
+      }
+  }
+
   /* This function will be called at the end of the transmission, to write the last bytes
    * to the file. However, this may be called also before, if necessary. */
   bool
@@ -233,22 +267,13 @@ namespace ns3
     AVPacket outputFrame;
     av_init_packet(&outputFrame);
 
-    unsigned int queueLength = m_packetizationQueue.size();
+    unsigned int queueLength = m_packetizationBuffer.GetSize();
     outputFrame.size = queueLength;
-    outputFrame.dts = m_timestampQueue.front();
-    outputFrame.pts = m_timestampQueue.front();
+    outputFrame.dts = GetNextTimestamp();
+    outputFrame.pts = outputFrame.dts;
 
-    uint8_t* tempBuffer = (uint8_t*) calloc(queueLength, sizeof(uint8_t));
-    assert(tempBuffer != NULL);
-
-    for (unsigned int i = 0; i < queueLength; i++)
-      {
-        tempBuffer[i] = m_packetizationQueue.front();
-        m_packetizationQueue.pop();
-        m_timestampQueue.pop();
-      }
-
-    outputFrame.data = tempBuffer;
+    outputFrame.data = (uint8_t*) ReadPacketizationData(queueLength);
+    ConsumeTimestamps(queueLength);
 
     /* Now I have to export the packet to the output context */
     if (av_interleaved_write_frame(m_outputFormatContext, &outputFrame) != 0)
@@ -259,15 +284,22 @@ namespace ns3
     av_free_packet(&outputFrame);
 
     av_write_trailer(m_outputFormatContext);
-    if (!(m_outputFormat->flags & AVFMT_NOFILE))
+    if (UsesCustomIo())
+      {
+        /* Release the custom I/O context, flushing all the data to the memory buffer
+         * or to the file */
+        avio_flush(m_outputFormatContext->pb);
+        CloseCustomIo();
+        m_outputFormatContext->pb = NULL;
+        m_fileOpen = false;
+      }
+    else if (!(m_outputFormat->flags & AVFMT_NOFILE))
       {
         /* close the output file */
         url_fclose(m_outputFormatContext->pb);
         m_fileOpen = false;
       }
 
-    free(tempBuffer);
-
     return true;
   }
 
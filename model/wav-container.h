@@ -42,10 +42,26 @@ namespace ns3
     FinalizeFile();
 
   protected:
-    std::queue<unsigned long int> m_timestampQueue;
+    /* A run of m_length contiguous bytes whose first byte has timestamp m_timestamp:
+     * every received packet contributes one run */
+    typedef struct TimestampRun
+    {
+      unsigned long int m_timestamp;
+      unsigned int m_length;
+    } TimestampRun;
+
+    std::queue<TimestampRun> m_timestampQueue;
 
     virtual bool
     PacketizeFromQueue();
+
+    /* Method used to return the timestamp of the next byte to be written */
+    unsigned long int
+    GetNextTimestamp();
+
+    /* Method used to advance the timestamp runs by length bytes */
+    void
+    ConsumeTimestamps(unsigned int length);
   };
 
 }